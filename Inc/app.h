@@ -3,5 +3,6 @@
 
 void runOne(void);
 void run(void);
+void appTick(void);
 
 #endif
@@ -0,0 +1,18 @@
+#ifndef CDC_RX_H
+#define CDC_RX_H
+
+#include "stdint.h"
+#include "slice.h"
+
+/**
+ * USB CDC receive into an rx_ring, the OUT endpoint writes straight into the
+ * ring. In usbd_cdc_if.c, CDC_Init_FS should call cdcRxStart() instead of
+ * setting UserRxBufferFS as the receive buffer, and CDC_Receive_FS should
+ * call cdcRxReceive(*Len) instead of re-arming the endpoint itself.
+ */
+void cdcRxStart(void);
+void cdcRxReceive(uint32_t len);
+uint8_t cdcRxGetLine(slice_t *line);
+uint32_t cdcRxGetLineDropCount(void);
+
+#endif
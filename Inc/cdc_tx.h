@@ -0,0 +1,25 @@
+#ifndef CDC_TX_H
+#define CDC_TX_H
+
+#include "stdint.h"
+
+// USB full speed bulk packet
+#define CDC_TX_PACKET                64
+
+/**
+ * Non blocking USB CDC transmit. Writers from any context queue into a
+ * tx_ring, the ring is sent in full 64 byte packets alternating between two
+ * buffers, and the next packet is started as soon as the previous one is
+ * done. CDC_TransmitCplt_FS in usbd_cdc_if.c should call cdcTxComplete()
+ * instead of setting usb_tx_len; left as is, cdcTxPoll() picks up usb_tx_len
+ * from the main loop at the cost of one loop pass per packet.
+ */
+void cdcTxInit(void);
+uint8_t cdcTxWrite(const void *data, uint16_t len);
+uint16_t cdcTxGetFree(void);
+void cdcTxPoll(void);
+void cdcTxComplete(void);
+uint32_t cdcTxGetDropCount(void);
+uint32_t cdcTxGetDropBytes(void);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include "stdint.h"
+#include "ton.h"
+#include "edge_detection.h"
+
+typedef struct
+{
+  ton_t ton;
+  edge_detection_t ed_raw;
+  uint32_t edge_time; // first sample of the current raw high run
+  uint8_t raw;
+  uint8_t state;      // confirmed state
+} debounce_t;
+
+uint8_t debounce(debounce_t *obj, uint8_t in, uint32_t now, uint32_t preset_time);
+uint32_t debounceGetEdgeTime(const debounce_t *obj);
+uint8_t debounceIsPending(const debounce_t *obj);
+void debounceReset(debounce_t *obj);
+
+#endif
@@ -8,6 +8,20 @@ typedef struct
   uint32_t aux;
 }edge_detection_t;
 
+/**
+ * Up to 32 signals, one bit each. All edges of a pass are computed at once,
+ * the result masks hold until the next edgeBankUpdate().
+ */
+typedef struct
+{
+  uint32_t prev;
+  uint32_t rising;
+  uint32_t falling;
+}edge_bank_t;
+
 uint8_t edgeDetection(edge_detection_t *obj, uint8_t val);
+void edgeBankUpdate(edge_bank_t *bank, uint32_t inputs);
+
+#define EDGE_BANK_RISING(bank, bit)   (((bank)->rising >> (bit)) & 1U)
 
 #endif
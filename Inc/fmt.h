@@ -0,0 +1,24 @@
+#ifndef FMT_H
+#define FMT_H
+
+#include "stdint.h"
+#include "stdarg.h"
+
+// fmtFixed() decimals are capped to this
+#define FMT_FIXED_MAX_DECIMALS       6
+
+/**
+ * Small bounded formatter, a subset of printf checked by the compiler:
+ * %d %i %u %x %X %c %s %% with the flags - 0 + and space, width,
+ * precision (also as *) and the hh h l ll length modifiers. No heap, no
+ * locale, no floating point. %f is not supported and ends the output,
+ * fixed point values go through fmtFixed() and %s. The output is cut to fit
+ * and always terminated.
+ */
+uint16_t fmtFormat(char *buf, uint16_t size, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+uint16_t fmtFormatV(char *buf, uint16_t size, const char *format, va_list va)
+    __attribute__((format(printf, 3, 0)));
+const char *fmtFixed(char *buf, uint16_t size, int32_t value, uint8_t decimals);
+
+#endif
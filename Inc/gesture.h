@@ -0,0 +1,82 @@
+#ifndef GESTURE_H
+#define GESTURE_H
+
+#include "stdint.h"
+#include "edge_detection.h"
+#include "ton.h"
+
+// Power of two, one slot is kept free to tell full from empty
+#define GESTURE_QUEUE_SIZE           8
+#define GESTURE_MAX                  32     // one edge and TON bank channel per row
+
+#if GESTURE_MAX > TON_BANK_CHANNELS
+#error "GESTURE_MAX must fit the TON bank"
+#endif
+
+typedef enum
+{
+    GESTURE_PRESS,      // chord held for hold_ms
+    GESTURE_RELEASE,    // chord let go after a PRESS would have fired
+    GESTURE_REPEAT,     // first after hold_ms, then every period_ms while held
+    GESTURE_DOUBLE      // two presses of hold_ms, released for at most period_ms between
+} gesture_type_t;
+
+/**
+ * One row of the const gesture table. chord is matched exactly against the
+ * packed button state, so a chord row and its single-button rows never fire
+ * together. Times are counted from the moment the chord was first matched.
+ */
+typedef struct
+{
+    uint32_t chord;
+    uint16_t hold_ms;
+    uint16_t period_ms;
+    uint8_t type;
+} gesture_def_t;
+
+typedef struct
+{
+    uint8_t id;         // row of the table
+    uint32_t time;
+} gesture_event_t;
+
+typedef struct
+{
+    uint32_t since;     // chord matched / released at
+    uint32_t next;      // next REPEAT time
+    uint8_t active;     // fired and the chord still held
+    uint8_t count;      // DOUBLE: presses so far
+} gesture_row_t;
+
+/**
+ * Runs a const table of up to GESTURE_MAX gestures over the packed button
+ * state and queues their events. Bit i of each mask is row i: an edge bank
+ * over the matched rows gives the presses and releases, a TON bank times the
+ * holds. Rows are only compared when the state changes, a pass with nothing
+ * changed and nothing due is a few mask operations. Main loop only.
+ */
+typedef struct
+{
+    const gesture_def_t *table;
+    gesture_row_t row[GESTURE_MAX];
+    uint8_t count;
+    uint32_t state;
+    uint32_t matched;   // rows whose chord equals state
+    uint32_t holding;   // matched rows whose hold_ms is still running
+    uint32_t repeating; // REPEAT rows past their hold
+    uint32_t next_due;  // earliest REPEAT time
+    edge_bank_t edges;
+    ton_bank_t holds;
+    gesture_event_t queue[GESTURE_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t tail;
+    uint32_t overflow_count;
+} gesture_t;
+
+void gestureInit(gesture_t *g, const gesture_def_t *table, uint8_t count);
+void gestureProcess(gesture_t *g, uint32_t state, uint32_t now);
+uint8_t gesturePop(gesture_t *g, gesture_event_t *event);
+uint8_t gestureIsActive(const gesture_t *g, uint8_t id);
+uint32_t gestureGetOverflowCount(const gesture_t *g);
+
+#endif
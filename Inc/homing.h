@@ -4,15 +4,55 @@
 #include "stdint.h"
 #include "ton.h"
 #include "edge_detection.h"
+#include "debounce.h"
+#include "running_stat.h"
+#include "trace.h"
 
 #define HOMING_DEBOUNCE_TIME          50
 #define HOMING_TIMEOUT               30000
 #define HOMING_SETTLE_TIME           100
+#define HOMING_MIN_TRAVEL_TIME       100    // shorter strokes are HOMING_ERROR_INVALID_TRAVEL
 #define HOMING_RETRY_COUNT           3
+#define HOMING_STOP_ON_FIRST_EDGE    0
+#define HOMING_STOP_CONFIRM_TIME     5      // raw contact held this long before stopping early
+#define HOMING_WARM_TOLERANCE_PCT    15
 
-#define ACTUATOR_STROKE_MM  100
+// Two speed profile, only used when setActuatorDuty is bound
+#define HOMING_FAST_DUTY             100
+#define HOMING_SLOW_DUTY             30
+#define HOMING_BACKOFF_TIME          150
+#define HOMING_RAMP_TIME             100 // 0 to 100 % duty
 
-#define HOMING_DEBUG
+// Adaptive windows, learned from previous runs
+#define HOMING_STATS_MIN_SAMPLES     3
+#define HOMING_TIMEOUT_SIGMA         4
+#define HOMING_TIMEOUT_SIGMA_MIN     50     // ms, floor of the stroke sigma
+#define HOMING_TIMEOUT_SLACK_PCT     25     // stroke window at least mean + this share
+#define HOMING_TIMEOUT_MARGIN        500
+#define HOMING_SETTLE_MIN_TIME       20
+
+#define HOMING_CONTACT_FIRST         0x01
+#define HOMING_CONTACT_FINAL         0x02
+#define HOMING_CALIB_MAGIC           0x484D4332U
+
+#define ACTUATOR_STROKE_MM  100    // switch to switch
+
+#define HOMING_POSITION_FULL         65536U // stroke in Q16, 0 = retract limit
+
+// Learned motion table, see homingStartLearn()
+#define HOMING_MOTION_KNOTS          8      // per direction, spanning half a stroke
+#define HOMING_MOTION_EXTEND         0
+#define HOMING_MOTION_RETRACT        1
+
+// Binary event trace, see homingSetTrace()
+#define HOMING_TRACE
+
+#ifdef HOMING_TRACE
+#define HOMING_TRACE_EVENT(homing, type, arg16, arg32) \
+    do { if ((homing)->trace) traceRecord((homing)->trace, (type), (homing)->trace_id, (uint16_t)(arg16), (uint32_t)(arg32)); } while (0)
+#else
+#define HOMING_TRACE_EVENT(homing, type, arg16, arg32) do { } while (0)
+#endif
 
 
 typedef enum
@@ -35,7 +75,8 @@ typedef enum
     HOMING_STATE_SETTLE_AT_RETRACT_2, //*		
     HOMING_STATE_MOVE_TO_CENTER,
     HOMING_STATE_COMPLETE,
-    HOMING_STATE_ERROR
+    HOMING_STATE_ERROR,
+    HOMING_STATE_LEARN              // homingStartLearn() passes, see homing_learn_state_t
 } homing_state_t;
 
 
@@ -48,15 +89,146 @@ typedef enum
     HOMING_ERROR_INVALID_TRAVEL
 } homing_error_t;
 
+typedef enum
+{
+    HOMING_SWITCH_RETRACT = 0,
+    HOMING_SWITCH_EXTEND
+} homing_switch_t;
+
 typedef struct
 {
+    homing_switch_t which;
+    uint32_t timestamp_us; // first raw edge, same time line as getMicros()
+} homing_switch_edge_t;
+
+typedef enum
+{
+    HOMING_LEARN_TO_RETRACT = 0,    // reach the retract switch once
+    HOMING_LEARN_SEGMENT,           // powered for the pass on-time, then stop
+    HOMING_LEARN_COAST,             // let it come to rest
+    HOMING_LEARN_TO_SWITCH,         // time the rest of the way to the far switch
+    HOMING_LEARN_SETTLE,
+    HOMING_LEARN_TO_CENTER
+} homing_learn_state_t;
+
+typedef enum
+{
+    HOMING_APPROACH_FAST = 0,
+    HOMING_APPROACH_BACKOFF,
+    HOMING_APPROACH_SLOW
+} homing_approach_t;
+
+typedef struct
+{
+    uint8_t fast_duty;      // %
+    uint8_t slow_duty;      // %
+    uint16_t backoff_ms;
+    uint16_t ramp_ms;       // time for a 0 to 100 % duty ramp, 0 = no ramp
+} homing_profile_t;
+
+// Persisted travel times and stroke statistics, see homingGetCalibration()/homingLoadCalibration()
+typedef struct
+{
+    uint32_t magic;
+    uint32_t extend_travel_time_us;
+    uint32_t retract_travel_time_us;
+    uint32_t check;
+    running_stat_t extend_travel_stat;
+    running_stat_t retract_travel_stat;
+} homing_calib_t;
+
+typedef struct
+{
+    void (*setActuatorDirection)(actuator_direction_t dir);
+    uint8_t (*readRetractSwitch)(void);
+    uint8_t (*readExtendSwitch)(void);
+    uint32_t (*getSysTick)(void);
+
+    // Optional interrupt capture path, leave NULL to measure with getSysTick
+    uint32_t (*getMicros)(void);
+    void (*armSwitchEdge)(homing_switch_t which);
+    uint8_t (*popSwitchEdge)(homing_switch_edge_t *edge);
+
+    // Optional PWM drive, enables the two speed profile
+    void (*setActuatorDuty)(uint8_t duty_percent);
+
+    // Optional, called when a full homing run produced new travel times
+    void (*saveCalibration)(const homing_calib_t *calib);
+} homing_funcs_t;
+
+// Dead reckoning position, valid while is_homed
+typedef struct
+{
+    uint32_t current_q16;
+    uint32_t start_q16;
+    uint32_t target_q16;
+    uint32_t min_q16;           // soft limits
+    uint32_t max_q16;
+    uint32_t extend_rate_q16;   // position units per ms, Q16.16
+    uint32_t retract_rate_q16;
+    uint32_t move_start_time;
+    uint32_t move_duration_ms;
+    actuator_direction_t move_dir;
+    uint8_t is_moving;
+    uint8_t start_pending;      // stopped to reverse, drives from move_start_time
+} homing_position_t;
+
+/**
+ * Distance covered from rest when driven for t ms and then stopped, per
+ * direction. Knots are step_ms apart from t = 0, past the last knot the
+ * distance grows at slope_q16. Start latency and coast are part of the knots.
+ */
+typedef struct
+{
+    uint32_t step_ms[2];
+    uint32_t distance_q16[2][HOMING_MOTION_KNOTS];
+    uint32_t slope_q16[2];          // Q16 position per ms in Q16.16
+    uint32_t latency_ms[2];         // drive on to the start switch opening
+    uint32_t coast_q16[2];          // run on after the drive stops
+    uint8_t valid;
+} homing_motion_t;
+
+typedef struct
+{
+    homing_learn_state_t state;
+    uint8_t started;                // first pass begun, retract switch reached
+    uint8_t pass;
+    uint8_t dir;                    // HOMING_MOTION_EXTEND / _RETRACT
+    uint8_t released;
+    uint32_t phase_start;
+    uint32_t on_time_ms;
+    uint32_t release_ms[2];
+    uint32_t to_switch_ms[2][HOMING_MOTION_KNOTS];
+} homing_learn_t;
+
+// Derived once per completed homing, see homingGetKinematics()
+typedef struct
+{
+    uint32_t extend_velocity_um_s;  // um/s, i.e. mm/s * 1000
+    uint32_t retract_velocity_um_s;
+    uint32_t speed_ratio_q16;       // extend / retract travel time
+    int32_t asymmetry_permille;     // (extend - retract) / mean travel time
+    uint8_t valid;
+} homing_kinematics_t;
+
+typedef struct
+{
+    // I/O bindings of this axis
+    const homing_funcs_t *funcs;
+
+    // Optional event trace, NULL if not recorded
+    trace_t *trace;
+    uint8_t trace_id;
+
     homing_state_t state;
     homing_state_t prevstate;
     homing_error_t error;
 
+    // Debounced switch inputs
+    debounce_t db_retract_switch;
+    debounce_t db_extend_switch;
+
     // TON timers
-    ton_t ton_retract_switch;
-    ton_t ton_extend_switch;
     ton_t ton_timeout;
     ton_t ton_settle;
     ton_t ton_center_move;
@@ -74,18 +246,64 @@ typedef struct
     uint8_t extend_switch_debounced;
     uint8_t extend_switch_pulse;
 
+    actuator_direction_t actuator_dir; // last commanded direction
+
+    // Drive profile
+    homing_profile_t profile;
+    homing_approach_t approach_phase;
+    uint32_t approach_phase_time;
+    uint32_t drive_start_time;
+    uint8_t drive_duty;
+    uint8_t drive_target_duty;
+    uint8_t drive_ramp_restart;
+
     // Timing measurements
+    uint32_t approach_start_time;
     uint32_t retract_limit_reached_time;
 	uint32_t extend_limit_reached_time;
     uint32_t extend_travel_time_ms;
 	uint32_t retract_travel_time_ms;
+    uint32_t extend_travel_time_us;
+    uint32_t retract_travel_time_us;
+
+    // Interrupt captured edges, used when the capture path is bound
+    uint32_t measure_start_us;
+    uint32_t retract_edge_us;
+    uint32_t extend_edge_us;
+    uint32_t retract_edge_paused_ms;    // paused_ms when the edge was captured
+    uint32_t extend_edge_paused_ms;
+    uint8_t retract_edge_valid;
+    uint8_t extend_edge_valid;
 
     // Configuration
     uint32_t debounce_time_ms;
     uint32_t timeout_ms;
     uint32_t settle_time_ms;
+    uint32_t min_travel_time_ms;
     uint8_t retry_count;
     uint8_t current_retry;
+    uint8_t stop_on_first_edge; // stop at a held raw contact, resume if debounce rejects it
+
+    // Statistics of past runs, in ms
+    running_stat_t extend_travel_stat;
+    running_stat_t retract_travel_stat;
+    running_stat_t bounce_stat;     // first raw contact to stable switch
+    uint32_t phase_timeout_ms;
+    uint32_t first_contact_time;
+    uint8_t contact_seen;
+    uint32_t pause_start_time;      // early stop on a contact the debounce may still reject
+    uint32_t paused_ms;             // early stops in the running measure, not travel
+
+    // Stored calibration for warm starts
+    homing_calib_t calib;
+    uint8_t calib_valid;
+    uint8_t warm_start;
+
+    // Positioning after homing
+    homing_position_t position;
+    homing_kinematics_t kinematics;
+    homing_motion_t motion;
+    homing_learn_t learn;
 
     // Status flags
     uint8_t is_homing_active;
@@ -94,17 +312,16 @@ typedef struct
 } homing_t;
 
 
-typedef struct
-{
-    void (*setActuatorDirection)(actuator_direction_t dir);
-    uint8_t (*readRetractSwitch)(void);
-    uint8_t (*readExtendSwitch)(void);
-    uint32_t (*getSysTick)(void);
-} homing_funcs_t;
-
 void homingInit(homing_t *homing, const homing_funcs_t *funcs);
+void homingSetTrace(homing_t *homing, trace_t *trace, uint8_t id);
 uint8_t homingStart(homing_t *homing);
+uint8_t homingStartWarm(homing_t *homing);
+uint8_t homingLoadCalibration(homing_t *homing, const homing_calib_t *calib);
+uint8_t homingGetCalibration(const homing_t *homing, homing_calib_t *calib);
 void homingProcess(homing_t *homing);
+void homingProcessAt(homing_t *homing, uint32_t current_time);
+uint8_t homingProcessEvent(homing_t *homing, uint32_t current_time, uint32_t *deadline);
+uint8_t homingNextDeadline(const homing_t *homing, uint32_t current_time, uint32_t *deadline);
 void homingAbort(homing_t *homing);
 uint8_t homingIsComplete(const homing_t *homing);
 uint8_t homingIsActive(const homing_t *homing);
@@ -112,4 +329,34 @@ homing_error_t homingGetError(const homing_t *homing);
 uint8_t homingGetProgress(const homing_t *homing);
 homing_state_t homingGetState(const homing_t *homing);
 
+uint8_t homingMoveTo(homing_t *homing, uint8_t percent);
+void homingStopMove(homing_t *homing);
+uint8_t homingIsMoving(const homing_t *homing);
+uint8_t homingGetPosition(const homing_t *homing);
+uint32_t homingGetPositionQ16(const homing_t *homing);
+void homingSetSoftLimits(homing_t *homing, uint8_t min_percent, uint8_t max_percent);
+
+const homing_kinematics_t *homingGetKinematics(const homing_t *homing);
+uint32_t homingGetExtendVelocity(const homing_t *homing);
+uint32_t homingGetRetractVelocity(const homing_t *homing);
+uint32_t homingGetSpeedRatioQ16(const homing_t *homing);
+int32_t homingGetAsymmetry(const homing_t *homing);
+uint16_t homingFormatKinematics(const homing_t *homing, char *buf, uint16_t size);
+
+uint8_t homingStartLearn(homing_t *homing);
+uint8_t homingLoadMotion(homing_t *homing, const homing_motion_t *motion);
+const homing_motion_t *homingGetMotion(const homing_t *homing);
+
+// Used by the homing state machine
+void homingLearnProcess(homing_t *homing, uint32_t current_time);
+uint8_t homingLearnDeadline(const homing_t *homing, uint32_t *deadline);
+uint32_t homingMotionDistance(const homing_t *homing, uint8_t dir, uint32_t time_ms);
+uint32_t homingMotionTime(const homing_t *homing, uint8_t dir, uint32_t distance_q16);
+void homingPositionDrive(homing_t *homing, actuator_direction_t dir);
+uint32_t homingRampTime(const homing_t *homing);
+void homingKinematicsUpdate(homing_t *homing);
+void homingPositionInit(homing_t *homing);
+void homingPositionCalibrate(homing_t *homing);
+void homingPositionProcess(homing_t *homing, uint32_t current_time);
+
 #endif
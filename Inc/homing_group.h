@@ -0,0 +1,45 @@
+#ifndef HOMING_GROUP_H
+#define HOMING_GROUP_H
+
+#include "stdint.h"
+#include "homing.h"
+
+#define HOMING_GROUP_MAX_AXES        16
+
+typedef uint16_t homing_axis_mask_t;
+
+typedef struct
+{
+    // Per-pass data, one bit per axis
+    homing_axis_mask_t active_mask;
+    homing_axis_mask_t homed_mask;
+    homing_axis_mask_t error_mask;
+    homing_axis_mask_t moving_mask;
+    homing_axis_mask_t timed_mask;  // deadline[] valid
+    homing_axis_mask_t due_mask;    // run on the next pass regardless
+    uint8_t axis_count;
+
+    uint32_t (*getSysTick)(void);
+
+    // Hot per-axis data, all a pass reads to decide whether an axis is due
+    const homing_funcs_t *funcs[HOMING_GROUP_MAX_AXES];
+    uint32_t deadline[HOMING_GROUP_MAX_AXES];
+    uint8_t switch_levels[HOMING_GROUP_MAX_AXES];  // bit 0 retract, bit 1 extend
+
+    // Per-axis state machines, only touched when the axis is due
+    homing_t axis[HOMING_GROUP_MAX_AXES];
+} homing_group_t;
+
+void homingGroupInit(homing_group_t *group, uint32_t (*getSysTick)(void));
+int8_t homingGroupAddAxis(homing_group_t *group, const homing_funcs_t *funcs);
+homing_axis_mask_t homingGroupStart(homing_group_t *group, homing_axis_mask_t mask);
+void homingGroupProcess(homing_group_t *group);
+homing_axis_mask_t homingGroupMoveTo(homing_group_t *group, homing_axis_mask_t mask, uint8_t percent);
+void homingGroupAbort(homing_group_t *group, homing_axis_mask_t mask);
+homing_t *homingGroupGetAxis(homing_group_t *group, uint8_t idx);
+homing_axis_mask_t homingGroupGetActiveMask(const homing_group_t *group);
+homing_axis_mask_t homingGroupGetHomedMask(const homing_group_t *group);
+homing_axis_mask_t homingGroupGetErrorMask(const homing_group_t *group);
+homing_axis_mask_t homingGroupGetMovingMask(const homing_group_t *group);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef LIMIT_CAPTURE_H
+#define LIMIT_CAPTURE_H
+
+#include "stdint.h"
+
+// Power of two, one slot is kept free to tell full from empty
+#define LIMIT_CAPTURE_QUEUE_SIZE     16
+#define LIMIT_CAPTURE_CHANNELS       32
+
+typedef struct
+{
+    uint32_t cycles;    // CYCCNT at the edge
+    uint8_t channel;
+    uint8_t level;
+} limit_capture_event_t;
+
+/**
+ * Single producer (EXTI ISR) / single consumer (main loop) queue of the first
+ * raw edge seen on each armed channel.
+ */
+typedef struct
+{
+    limit_capture_event_t queue[LIMIT_CAPTURE_QUEUE_SIZE];
+    volatile uint8_t head;  // written by ISR only
+    volatile uint8_t tail;  // written by consumer only
+    volatile uint8_t armed[LIMIT_CAPTURE_CHANNELS];
+    volatile uint32_t overflow_count;
+} limit_capture_t;
+
+void limitCaptureInit(limit_capture_t *cap);
+void limitCaptureArm(limit_capture_t *cap, uint8_t channel);
+void limitCaptureDisarm(limit_capture_t *cap, uint8_t channel);
+void limitCaptureFromISR(limit_capture_t *cap, uint8_t channel, uint8_t level, uint32_t cycles);
+uint8_t limitCapturePop(limit_capture_t *cap, limit_capture_event_t *event);
+uint32_t limitCaptureGetOverflowCount(const limit_capture_t *cap);
+
+#endif
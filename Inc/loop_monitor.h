@@ -0,0 +1,45 @@
+#ifndef LOOP_MONITOR_H
+#define LOOP_MONITOR_H
+
+#include "stdint.h"
+
+#define LOOP_MONITOR_BUDGET_US       5000
+// Bucket i counts [2^i, 2^(i+1)) us, the last one is open ended
+#define LOOP_MONITOR_HIST_BUCKETS    20
+#define LOOP_MONITOR_WORST           4
+
+typedef struct
+{
+  uint32_t exec_us;
+  uint32_t period_us;   // start to start, includes the time outside run()
+  uint32_t start_us;
+  uint8_t tag;          // caller state while the iteration ran
+} loop_sample_t;
+
+/**
+ * Super-loop health: period and execution time histograms of every
+ * iteration, the worst ones by execution time and an overrun event once an
+ * iteration runs longer than the budget. Main loop only.
+ */
+typedef struct
+{
+  uint32_t budget_us;
+  uint32_t iterations;
+  uint32_t overrun_count;
+  uint32_t period_hist[LOOP_MONITOR_HIST_BUCKETS];
+  uint32_t exec_hist[LOOP_MONITOR_HIST_BUCKETS];
+  uint32_t max_period_us;
+  loop_sample_t worst[LOOP_MONITOR_WORST];  // longest first
+  loop_sample_t current;
+  loop_sample_t overrun;                    // last one, until taken
+  uint8_t overrun_pending;
+  uint8_t started;
+} loop_monitor_t;
+
+void loopMonitorInit(loop_monitor_t *lm, uint32_t budget_us);
+void loopMonitorBegin(loop_monitor_t *lm, uint32_t now_us, uint8_t tag);
+void loopMonitorEnd(loop_monitor_t *lm, uint32_t now_us);
+uint8_t loopMonitorTakeOverrun(loop_monitor_t *lm, loop_sample_t *overrun);
+void loopMonitorDump(const loop_monitor_t *lm);
+
+#endif
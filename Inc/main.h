@@ -77,6 +77,7 @@ void Error_Handler(void);
 //#define SWITCH_RETRACT_PIN		LED_ORANGE_Pin
 //#define SWITCH_EXTEND_PORT		LED_ORANGE_GPIO_Port
 //#define SWITCH_EXTEND_PIN		LED_ORANGE_Pin
+//#define ACTUATOR_CURRENT_ADC	hadc1 // sensorless homing, motor current on a circular DMA ADC
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
@@ -0,0 +1,39 @@
+#ifndef PORT_DEBOUNCE_H
+#define PORT_DEBOUNCE_H
+
+#include "stdint.h"
+
+#define PORT_DEBOUNCE_PORTS          4
+
+typedef struct
+{
+  volatile const uint32_t *idr;   // input data register, low 16 bits are the pins
+  uint16_t mask;                  // pins taken from this port
+  uint16_t active_low;            // pins that read 0 when active
+  uint16_t ct0;                   // vertical counter, bit 0 of every pin
+  uint16_t ct1;                   // vertical counter, bit 1 of every pin
+  volatile uint16_t stable;       // debounced, 1 = active
+  uint16_t rising;                // accumulated until taken by the main loop
+  uint16_t falling;
+} port_debounce_port_t;
+
+/**
+ * Debounces every pin of up to PORT_DEBOUNCE_PORTS GPIO ports at once from a
+ * fixed rate interrupt. A pin changes state after 4 equal samples in a row,
+ * so the latency is exactly 4 ticks. Written by portDebounceTick() only, the
+ * main loop reads the stable masks and takes the edges atomically.
+ */
+typedef struct
+{
+  port_debounce_port_t port[PORT_DEBOUNCE_PORTS];
+  uint8_t count;
+} port_debounce_t;
+
+void portDebounceInit(port_debounce_t *pd);
+int8_t portDebounceAddPort(port_debounce_t *pd, volatile const uint32_t *idr, uint16_t mask, uint16_t active_low);
+void portDebounceTick(port_debounce_t *pd);
+uint16_t portDebounceStable(const port_debounce_t *pd, uint8_t port);
+uint16_t portDebounceTakeRising(port_debounce_t *pd, uint8_t port);
+uint16_t portDebounceTakeFalling(port_debounce_t *pd, uint8_t port);
+
+#endif
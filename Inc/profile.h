@@ -0,0 +1,76 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "stdint.h"
+
+// Comment out to compile every PROFILE_SCOPE() away
+#define PROFILE_ENABLE
+
+#define PROFILE_MAX_PROBES           16
+// Bucket i counts [2^i, 2^(i+1)) cycles, the last one is open ended
+#define PROFILE_HIST_BUCKETS         24
+
+#ifdef PROFILE_HOST
+#if defined(PROFILE_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+#define PROFILE_UNIT                 "tsc"
+#define PROFILE_NOW()                ((uint32_t)__builtin_ia32_rdtsc())
+#else
+#include "steady_clock.h"
+#define PROFILE_UNIT                 "ns"
+#define PROFILE_NOW()                steadyClockCycles()
+#endif
+#else
+#include "main.h"
+#define PROFILE_UNIT                 "cycles"
+#define PROFILE_NOW()                (DWT->CYCCNT)
+#endif
+
+typedef struct
+{
+  const char *name;
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t hist[PROFILE_HIST_BUCKETS];
+  uint8_t registered;
+} profile_probe_t;
+
+typedef struct
+{
+  profile_probe_t *probe;
+  uint32_t start;
+} profile_scope_t;
+
+void profileRecord(profile_probe_t *probe, uint32_t cycles);
+void profileReset(void);
+void profileDump(void);
+
+static inline profile_scope_t profileScopeBegin(profile_probe_t *probe)
+{
+  profile_scope_t scope = {probe, PROFILE_NOW()};
+  return scope;
+}
+
+static inline void profileScopeEnd(profile_scope_t *scope)
+{
+  profileRecord(scope->probe, PROFILE_NOW() - scope->start);
+}
+
+#define PROFILE_CAT2(a, b) a##b
+#define PROFILE_CAT(a, b) PROFILE_CAT2(a, b)
+
+/**
+ * Time the rest of the enclosing block under probe_name, every return path
+ * included. A probe belongs to one context: main loop or a single ISR.
+ */
+#ifdef PROFILE_ENABLE
+#define PROFILE_SCOPE(probe_name) \
+  static profile_probe_t PROFILE_CAT(profile_probe_, __LINE__) = {.name = (probe_name)}; \
+  profile_scope_t PROFILE_CAT(profile_scope_, __LINE__) __attribute__((cleanup(profileScopeEnd))) = \
+      profileScopeBegin(&PROFILE_CAT(profile_probe_, __LINE__))
+#else
+#define PROFILE_SCOPE(probe_name) do {} while (0)
+#endif
+
+#endif
@@ -9,9 +9,9 @@
 #define RETARGET_H_
 
 #include "stdint.h"
+#include "slice.h"
 
-void print(const char *format, ...);
-int scan(const char *format, ... );
-uint16_t getline(char *buf);
+void print(const char *format, ...) __attribute__((format(printf, 1, 2)));
+uint8_t scanLine(slice_t *line);
 
 #endif /* RETARGET_H_ */
@@ -0,0 +1,22 @@
+#ifndef RUNNING_STAT_H
+#define RUNNING_STAT_H
+
+#include "stdint.h"
+
+// Older samples are halved away once this many are collected
+#define RUNNING_STAT_WINDOW          32
+
+typedef struct
+{
+  uint32_t count;
+  uint32_t sum;
+  uint64_t sum_sq;
+} running_stat_t;
+
+void runningStatReset(running_stat_t *obj);
+void runningStatAdd(running_stat_t *obj, uint32_t sample);
+uint32_t runningStatCount(const running_stat_t *obj);
+uint32_t runningStatMean(const running_stat_t *obj);
+uint32_t runningStatSigma(const running_stat_t *obj);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef RX_RING_H
+#define RX_RING_H
+
+#include "stdint.h"
+#include "slice.h"
+
+#define RX_RING_SIZE                 1024
+// Room reserved for each receive, one full speed packet
+#define RX_RING_PACKET               64
+// Longer lines are dropped up to their terminator and counted
+#define RX_RING_LINE_MAX             128
+
+/**
+ * Single producer / single consumer bip buffer. The producer (the USB OUT
+ * interrupt) reserves a contiguous packet sized block, the endpoint receives
+ * straight into it, and the block is committed with the received length.
+ * When the tail is too short the producer wraps to the start and the data
+ * before the wrap mark is read first. With no room the producer stalls and
+ * the endpoint NAKs until the consumer frees space, so nothing is lost.
+ *
+ * The consumer frames lines ending in '\r' or '\n' in place and hands them
+ * out as slices into the ring. Only a line straddling the wrap is copied,
+ * into line_copy.
+ */
+typedef struct
+{
+    uint8_t buf[RX_RING_SIZE] __attribute__((aligned(4)));
+    volatile uint16_t write;    // end of committed data
+    volatile uint16_t wrap;     // end of data before a wrap, valid while write < read
+    volatile uint16_t read;     // start of unread data
+    uint16_t reserved;          // start of the block being received
+    uint16_t scanned;           // bytes after read already searched for a terminator
+    uint16_t line_pending;      // bytes held by the line handed out, released on the next call
+    uint8_t discarding;         // dropping the rest of an overlong line
+    volatile uint32_t line_drop_count;
+    char line_copy[RX_RING_LINE_MAX];
+} rx_ring_t;
+
+void rxRingInit(rx_ring_t *ring);
+uint8_t *rxRingReserve(rx_ring_t *ring);
+void rxRingCommit(rx_ring_t *ring, uint16_t len);
+uint8_t rxRingGetLine(rx_ring_t *ring, slice_t *line);
+uint32_t rxRingGetLineDropCount(const rx_ring_t *ring);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef SLICE_H
+#define SLICE_H
+
+#include "stdint.h"
+
+/**
+ * Read only view of bytes owned by someone else, e.g. a received line still
+ * in the RX ring. Not terminated.
+ */
+typedef struct
+{
+    const char *ptr;
+    uint16_t len;
+} slice_t;
+
+uint8_t sliceNextToken(slice_t *rest, slice_t *token, char delim);
+uint8_t sliceEquals(slice_t s, const char *str);
+uint8_t sliceToInt(slice_t s, int32_t *value);
+void sliceTrim(slice_t *s);
+
+#endif
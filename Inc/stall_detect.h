@@ -0,0 +1,56 @@
+#ifndef STALL_DETECT_H
+#define STALL_DETECT_H
+
+#include "stdint.h"
+
+// Defaults in samples / ADC counts, see stallDetectInit()
+#define STALL_DETECT_BLANK           500     // inrush after a drive start
+#define STALL_DETECT_SHIFT           6       // baseline EMA weight 1/64
+#define STALL_DETECT_RATIO_Q8        512     // stall above 2.0 x baseline ...
+#define STALL_DETECT_MARGIN          100     // ... plus this many counts
+#define STALL_DETECT_CONFIRM         20      // consecutive samples over threshold
+#define STALL_DETECT_LEVEL           0       // absolute stall level, 0 = off
+#define STALL_DETECT_INRUSH_Q8       192     // still at 0.75 x inrush peak after blanking = stalled, 0 = off
+
+#define STALL_DETECT_CMD_NONE        0
+#define STALL_DETECT_CMD_ARM         1
+#define STALL_DETECT_CMD_DISARM      2
+
+/**
+ * Streaming end-of-stroke detector on motor current samples. Fed from the
+ * ADC DMA interrupt, armed and read from the main loop. The main loop only
+ * posts commands, the detector state is owned by the feeding context.
+ */
+typedef struct
+{
+    // Configuration
+    uint16_t blank_samples;
+    uint16_t ratio_q8;
+    uint16_t margin;
+    uint16_t confirm_samples;
+    uint16_t level;
+    uint16_t inrush_ratio_q8;
+    uint8_t shift;
+
+    // Written by the feeding context only
+    uint32_t baseline_q8;
+    uint16_t blank_left;
+    uint16_t over_count;
+    uint16_t inrush_peak;
+    uint8_t seeded;
+    uint8_t armed;
+    volatile uint8_t stalled;
+    volatile uint16_t peak;
+
+    // Posted by the main loop, consumed by stallDetectFeed()
+    volatile uint8_t command;
+} stall_detect_t;
+
+void stallDetectInit(stall_detect_t *sd);
+void stallDetectArm(stall_detect_t *sd);
+void stallDetectDisarm(stall_detect_t *sd);
+uint8_t stallDetectFeed(stall_detect_t *sd, const uint16_t *samples, uint16_t count);
+uint8_t stallDetectIsStalled(const stall_detect_t *sd);
+uint16_t stallDetectGetBaseline(const stall_detect_t *sd);
+
+#endif
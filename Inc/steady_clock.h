@@ -8,9 +8,40 @@
 #ifndef STEADY_CLOCK_H_
 #define STEADY_CLOCK_H_
 
+#include "stdint.h"
 
+/**
+ * Monotonic 64 bit clock. On the target it is CYCCNT extended in software by
+ * steadyClockTick() from the SysTick handler, every reader below is safe from
+ * any context. Built with STEADY_CLOCK_HOST it runs on clock_gettime(), or on
+ * a virtual clock moved by steadyClockHostAdvance() once one is set.
+ */
+
+// Fixed point unit per cycle: whole + frac / 2^64, precomputed from the core clock
+typedef struct
+{
+   uint32_t whole;
+   uint64_t frac;
+   uint32_t divisor;    // cycles per unit if that is an integer, else 0
+} steady_clock_scale_t;
 
 void steadyClockEnable(void);
-float getusec(void);
+void steadyClockTick(void);
+
+uint64_t steadyClockCycles64(void);
+uint64_t steadyClockUsec64(void);
+uint64_t steadyClockNsec64(void);
+uint64_t steadyClockCyclesToUsec(uint64_t cycles);
+uint64_t steadyClockCyclesToNsec(uint64_t cycles);
+uint32_t steadyClockFrequency(void);
+
+uint32_t steadyClockCycles(void);
+uint32_t steadyClockUsec(void);
+uint32_t steadyClockStampToUsec(uint32_t cycle_stamp);
+
+#ifdef STEADY_CLOCK_HOST
+void steadyClockHostSetVirtual(uint32_t frequency);
+void steadyClockHostAdvance(uint64_t cycles);
+#endif
 
 #endif /* STEADY_CLOCK_H_ */
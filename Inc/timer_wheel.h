@@ -0,0 +1,48 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "stdint.h"
+
+// 5 levels of 32 slots, 1 tick resolution up to 2^25 ticks (~9.3 h at 1 ms)
+#define TIMER_WHEEL_BITS             5
+#define TIMER_WHEEL_SLOTS            (1U << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS           5
+#define TIMER_WHEEL_MAX_DELAY        ((1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+typedef struct wheel_timer wheel_timer_t;
+typedef void (*wheel_timer_callback_t)(wheel_timer_t *timer, void *context);
+
+struct wheel_timer
+{
+    wheel_timer_t *next;
+    wheel_timer_t **pprev;      // link that points at this timer, NULL when idle
+    uint32_t expires;
+    uint32_t period;            // 0 = one shot
+    wheel_timer_callback_t callback;    // optional, NULL = poll timerWheelExpired()
+    void *context;
+    uint8_t slot;               // level * TIMER_WHEEL_SLOTS + index
+    uint8_t expired;
+};
+
+/**
+ * Hierarchical timing wheel. Start and cancel are O(1) and idle timers are
+ * not visited at all. Timers live in the caller's memory, the wheel only
+ * links them. Main loop only, not for interrupt context.
+ */
+typedef struct
+{
+    wheel_timer_t *slot[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint32_t occupied[TIMER_WHEEL_LEVELS];  // bit per non-empty slot
+    uint32_t now;                           // last tick processed
+} timer_wheel_t;
+
+void timerWheelInit(timer_wheel_t *tw, uint32_t now);
+void timerWheelSetCallback(wheel_timer_t *timer, wheel_timer_callback_t callback, void *context);
+void timerWheelStart(timer_wheel_t *tw, wheel_timer_t *timer, uint32_t delay, uint32_t period);
+void timerWheelCancel(timer_wheel_t *tw, wheel_timer_t *timer);
+uint8_t timerWheelIsActive(const wheel_timer_t *timer);
+uint8_t timerWheelExpired(wheel_timer_t *timer);
+void timerWheelAdvance(timer_wheel_t *tw, uint32_t now);
+uint8_t timerWheelNextExpiry(const timer_wheel_t *tw, uint32_t *deadline);
+
+#endif
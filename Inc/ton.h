@@ -9,6 +9,25 @@ typedef struct
   uint32_t aux;
 } ton_t;
 
+#define TON_BANK_CHANNELS 32
+
+/**
+ * TON for up to 32 inputs, bit i of a mask is channel i.
+ * Struct of arrays: the per-pass work is a few mask operations plus one
+ * compare per channel still timing.
+ */
+typedef struct
+{
+  uint32_t since[TON_BANK_CHANNELS];    // end time of a running channel
+  uint32_t preset[TON_BANK_CHANNELS];
+  uint32_t running;
+  uint32_t done;
+  uint32_t next;                        // earliest end time among running, not done
+}ton_bank_t;
+
 uint8_t TON(ton_t *obj, uint8_t in, uint32_t now, uint32_t preset_time);
+void tonBankInit(ton_bank_t *bank);
+void tonBankSetPreset(ton_bank_t *bank, uint8_t channel, uint32_t preset_time);
+uint32_t tonBankUpdate(ton_bank_t *bank, uint32_t inputs, uint32_t now);
 
 #endif /* TON_H */
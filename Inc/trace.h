@@ -0,0 +1,64 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "stdint.h"
+
+// Power of two
+#define TRACE_BUFFER_SIZE            128
+
+// Packet on the CDC stream shared with print() text: 4 byte header +
+// TRACE_RECORDS_PER_PACKET records + CRC-16. MAGIC0 is not ASCII, so a host
+// resyncs on it and drops candidates whose CRC does not match.
+#define TRACE_PACKET_MAGIC0          0xA5
+#define TRACE_PACKET_MAGIC1          'R'
+#define TRACE_RECORDS_PER_PACKET     5
+#define TRACE_PACKET_SIZE            (4 + TRACE_RECORDS_PER_PACKET * sizeof(trace_record_t) + 2)
+
+typedef enum
+{
+    TRACE_HOMING_STATE = 1,     // arg16 new state, arg32 previous state
+    TRACE_HOMING_SWITCH,        // arg16 switch | level << 8, arg32 0 raw / 1 debounced
+    TRACE_HOMING_ACTUATOR,      // arg16 direction, arg32 duty
+    TRACE_HOMING_ERROR,         // arg16 error
+    TRACE_HOMING_TRAVEL,        // arg16 switch, arg32 travel time in us
+    TRACE_HOMING_RETRY,         // arg16 retry, arg32 retry count
+    TRACE_HOMING_WARM_REJECT,   // arg32 approach time in ms
+    TRACE_HOMING_COMPLETE       // arg16 switch | warm start << 8, arg32 stroke in ms, one per switch
+} trace_type_t;
+
+typedef struct
+{
+    uint32_t timestamp;
+    uint32_t arg32;
+    uint16_t arg16;
+    uint8_t type;
+    uint8_t source;
+} trace_record_t;
+
+typedef struct
+{
+    volatile uint32_t seq;
+    trace_record_t record;
+} trace_slot_t;
+
+/**
+ * Bounded multi producer / single consumer ring. Producers never wait, a
+ * full ring drops the record and counts it.
+ */
+typedef struct
+{
+    trace_slot_t slot[TRACE_BUFFER_SIZE];
+    volatile uint32_t head;
+    uint32_t tail;
+    volatile uint32_t drop_count;
+    uint32_t (*timestamp)(void);
+} trace_t;
+
+void traceInit(trace_t *trace, uint32_t (*timestamp)(void));
+void traceRecord(trace_t *trace, trace_type_t type, uint8_t source, uint16_t arg16, uint32_t arg32);
+uint8_t tracePop(trace_t *trace, trace_record_t *record);
+uint32_t traceGetDropCount(const trace_t *trace);
+uint16_t traceFillPacket(trace_t *trace, uint8_t *packet, uint8_t seq);
+void traceDrainCdc(trace_t *trace);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef TX_RING_H
+#define TX_RING_H
+
+#include "stdint.h"
+
+// Power of two
+#define TX_RING_SIZE                 1024
+// Per write: 2 byte length + commit flag
+#define TX_RING_HEADER               3
+
+/**
+ * Multi producer / single consumer byte ring. A writer claims room for its
+ * whole message with one CAS on the head and publishes it with a commit flag,
+ * so writes from any context never interleave and never wait. The reader
+ * stops at the first message still being written. A full ring drops the
+ * message and counts it.
+ */
+typedef struct
+{
+    volatile uint8_t buf[TX_RING_SIZE];
+    volatile uint32_t head;     // claimed by writers
+    volatile uint32_t tail;     // freed by the reader
+    uint16_t offset;            // read position inside the message at tail
+    volatile uint32_t drop_count;
+    volatile uint32_t drop_bytes;
+} tx_ring_t;
+
+void txRingInit(tx_ring_t *ring);
+uint8_t txRingWrite(tx_ring_t *ring, const void *data, uint16_t len);
+uint16_t txRingRead(tx_ring_t *ring, uint8_t *out, uint16_t max);
+uint8_t txRingIsEmpty(const tx_ring_t *ring);
+uint16_t txRingGetFree(const tx_ring_t *ring);
+uint32_t txRingGetDropCount(const tx_ring_t *ring);
+uint32_t txRingGetDropBytes(const tx_ring_t *ring);
+
+#endif
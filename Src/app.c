@@ -1,6 +1,71 @@
 #include "app.h"
 #include "main.h"
 #include "homing.h"
+#include "steady_clock.h"
+#include "limit_capture.h"
+#include "trace.h"
+#include "stall_detect.h"
+#include "timer_wheel.h"
+#include "port_debounce.h"
+#include "cdc_tx.h"
+#include "retarget.h"
+
+#if defined(ACTUATOR_CURRENT_ADC) && !defined(SWITCH_RETRACT_PIN)
+#define HOMING_SENSORLESS
+
+#define CURRENT_DMA_HALF		64
+
+extern ADC_HandleTypeDef ACTUATOR_CURRENT_ADC;
+
+static uint16_t current_dma[2 * CURRENT_DMA_HALF];
+static stall_detect_t stall_detect;
+static volatile actuator_direction_t stall_dir = ACTUATOR_DIR_STOP;
+// A stall at the end of stroke stands in for the limit switch of that side
+static volatile uint8_t virtual_switch[2];
+
+static void sensorlessDirection(actuator_direction_t dir)
+{
+	if (dir == stall_dir)
+		return;
+
+	stall_dir = dir;
+
+	if (dir == ACTUATOR_DIR_STOP)
+	{
+		stallDetectDisarm(&stall_detect);
+		return;
+	}
+
+	// Moving off an end stop releases its switch
+	virtual_switch[dir == ACTUATOR_DIR_EXTEND ? 0 : 1] = 0;
+	stallDetectArm(&stall_detect);
+}
+
+static void feedCurrent(const uint16_t *samples)
+{
+	if (stallDetectFeed(&stall_detect, samples, CURRENT_DMA_HALF))
+	{
+		actuator_direction_t dir = stall_dir;
+
+		if (dir == ACTUATOR_DIR_RETRACT)
+			virtual_switch[0] = 1;
+		else if (dir == ACTUATOR_DIR_EXTEND)
+			virtual_switch[1] = 1;
+	}
+}
+
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
+{
+	if (hadc == &ACTUATOR_CURRENT_ADC)
+		feedCurrent(&current_dma[0]);
+}
+
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+	if (hadc == &ACTUATOR_CURRENT_ADC)
+		feedCurrent(&current_dma[CURRENT_DMA_HALF]);
+}
+#endif
 
 static void setActuatorDirection(actuator_direction_t dir)
 {
@@ -22,18 +87,30 @@ static void setActuatorDirection(actuator_direction_t dir)
             HAL_GPIO_WritePin(ACTUATOR_RETRACT_PORT, ACTUATOR_RETRACT_PIN, GPIO_PIN_RESET);
             break;
     }
+
+#ifdef HOMING_SENSORLESS
+    sensorlessDirection(dir);
+#endif
 }
 
 uint8_t retractswitch, extendswitch;
 static uint8_t readRetractSwitch(void)
 {
+#ifdef HOMING_SENSORLESS
+	return virtual_switch[0];
+#else
 	return retractswitch;
+#endif
     //return HAL_GPIO_ReadPin(SWITCH_RETRACT_PORT, SWITCH_RETRACT_PIN);
 }
 
 static uint8_t readExtendSwitch(void)
 {
+#ifdef HOMING_SENSORLESS
+	return virtual_switch[1];
+#else
 	return extendswitch;
+#endif
     //return HAL_GPIO_ReadPin(SWITCH_EXTEND_PORT, SWITCH_EXTEND_PIN);
 }
 
@@ -42,40 +119,184 @@ static uint32_t getSysTick(void)
     return HAL_GetTick();
 }
 
+#if defined(SWITCH_RETRACT_PIN) && defined(SWITCH_EXTEND_PIN)
+#define HOMING_EDGE_CAPTURE
+
+static limit_capture_t limit_capture;
+// Set by the EXTI, catches a bounce that is back at its old level by the next pass
+static volatile uint8_t switch_event;
+
+// EXTI on both switch pins, rising and falling
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	uint32_t cycles = steadyClockCycles();
+
+	switch_event = 1;
+
+	if (GPIO_Pin == SWITCH_RETRACT_PIN)
+	{
+		limitCaptureFromISR(&limit_capture, HOMING_SWITCH_RETRACT,
+				HAL_GPIO_ReadPin(SWITCH_RETRACT_PORT, SWITCH_RETRACT_PIN), cycles);
+	}
+	else if (GPIO_Pin == SWITCH_EXTEND_PIN)
+	{
+		limitCaptureFromISR(&limit_capture, HOMING_SWITCH_EXTEND,
+				HAL_GPIO_ReadPin(SWITCH_EXTEND_PORT, SWITCH_EXTEND_PIN), cycles);
+	}
+}
+
+static void armSwitchEdge(homing_switch_t which)
+{
+	limitCaptureArm(&limit_capture, (uint8_t)which);
+}
+
+static uint8_t popSwitchEdge(homing_switch_edge_t *edge)
+{
+	limit_capture_event_t event;
+
+	if (!limitCapturePop(&limit_capture, &event))
+		return 0;
+
+	edge->which = (homing_switch_t)event.channel;
+	edge->timestamp_us = steadyClockStampToUsec(event.cycles);
+	return 1;
+}
+#endif
+
 
 static homing_t homing_obj;
+static trace_t homing_trace;
 
 static const homing_funcs_t homing_funcs =
 {
     .setActuatorDirection = setActuatorDirection,
     .readRetractSwitch = readRetractSwitch,
     .readExtendSwitch = readExtendSwitch,
-    .getSysTick = getSysTick
+    .getSysTick = getSysTick,
+#ifdef HOMING_EDGE_CAPTURE
+    .getMicros = steadyClockUsec,
+    .armSwitchEdge = armSwitchEdge,
+    .popSwitchEdge = popSwitchEdge
+#endif
 };
 
-static ton_t ton_btn_startstop;
-static edge_detection_t ed_btn_startstop;
+// Ports are sampled every INPUT_SAMPLE_MS, a pin settles after 4 samples
+#define INPUT_SAMPLE_MS		5
 
-static ton_t ton_blink;
+static port_debounce_t input_ports;
+static int8_t btn_port = -1;
+
+static timer_wheel_t app_timers;
+static wheel_timer_t blink_timer;
 
 static uint8_t blink;
 
+// Homing only runs on a switch change, a command or its own deadline
+static uint8_t switch_levels;
+static uint8_t homing_timed;
+static uint32_t homing_deadline;
+
+// SysTick context
+void appTick(void)
+{
+	static uint8_t divider;
+
+	if (++divider >= INPUT_SAMPLE_MS)
+	{
+		divider = 0;
+		portDebounceTick(&input_ports);
+	}
+}
+
+// USB commands, one per line: HOME, ABORT, MOVE:<percent>
+// Returns 1 if a command reached the homing
+static uint8_t handleUsbCommands(void)
+{
+	slice_t line, cmd;
+	uint8_t handled = 0;
+
+	while (scanLine(&line))
+	{
+		if (!sliceNextToken(&line, &cmd, ':'))
+			continue;
+
+		if (sliceEquals(cmd, "HOME"))
+		{
+			if (!homingIsActive(&homing_obj))
+				handled |= homingStart(&homing_obj);
+		}
+		else if (sliceEquals(cmd, "ABORT"))
+		{
+			homingAbort(&homing_obj);
+			handled = 1;
+		}
+		else if (sliceEquals(cmd, "MOVE"))
+		{
+			slice_t arg;
+			int32_t percent;
+
+			if (sliceNextToken(&line, &arg, ',') && sliceToInt(arg, &percent) && percent >= 0 && percent <= 100)
+				handled |= homingMoveTo(&homing_obj, (uint8_t)percent);
+		}
+	}
+
+	return handled;
+}
+
 void runOne(void)
 {
+	steadyClockEnable();
+	cdcTxInit();
+	portDebounceInit(&input_ports);
+	btn_port = portDebounceAddPort(&input_ports, &BTN_GPIO_Port->IDR, BTN_Pin, 0);
+#ifdef HOMING_EDGE_CAPTURE
+	limitCaptureInit(&limit_capture);
+#endif
 	homingInit(&homing_obj, &homing_funcs);
+#ifdef HOMING_SENSORLESS
+	stallDetectInit(&stall_detect);
+	HAL_ADC_Start_DMA(&ACTUATOR_CURRENT_ADC, (uint32_t *)current_dma, 2 * CURRENT_DMA_HALF);
+#endif
+
+	traceInit(&homing_trace, steadyClockCycles);
+	homingSetTrace(&homing_obj, &homing_trace, 0);
+
+	timerWheelInit(&app_timers, HAL_GetTick());
+	timerWheelStart(&app_timers, &blink_timer, 100, 100);
 }
 
 void run(void)
 {
 	uint32_t now = HAL_GetTick();
-	uint8_t start_pulse = HAL_GPIO_ReadPin(BTN_GPIO_Port, BTN_Pin);
-	start_pulse = TON(&ton_btn_startstop, start_pulse, now, 50);
-	start_pulse = edgeDetection(&ed_btn_startstop, start_pulse);
+	timerWheelAdvance(&app_timers, now);
+
+	uint8_t start_pulse = (portDebounceTakeRising(&input_ports, (uint8_t)btn_port) & BTN_Pin) != 0;
+	uint8_t homing_due = 0;
 
 	if(start_pulse && !homingIsActive(&homing_obj))
-		{homingStart(&homing_obj);}
+		{homing_due = homingStart(&homing_obj);}
+
+	homing_due |= handleUsbCommands();
 
-	homingProcess(&homing_obj);
+	uint8_t levels = readRetractSwitch() | (uint8_t)(readExtendSwitch() << 1);
+
+#ifdef HOMING_EDGE_CAPTURE
+	if (switch_event)
+	{
+		switch_event = 0;
+		homing_due = 1;
+	}
+#endif
+
+	if (homing_due || levels != switch_levels ||
+			(homing_timed && (int32_t)(homing_deadline - now) <= 0))
+	{
+		switch_levels = levels;
+		homing_timed = homingProcessEvent(&homing_obj, now, &homing_deadline);
+	}
+
+	traceDrainCdc(&homing_trace);
+	cdcTxPoll();
 
 	if (homingIsActive(&homing_obj))
 	{
@@ -97,12 +318,30 @@ void run(void)
 	}
 
 	// BLINKS
-	if (TON(&ton_blink, 1, now, 100))
+	if (timerWheelExpired(&blink_timer))
 	{
-		ton_blink.aux = 0;
 		blink = !blink;
 	}
 	//blink_pulse = edgeDetection(&ed_blink, blink_pulse);
+
+	// Earliest of the homing deadline and the next timer
+	uint8_t timed = homing_timed;
+	uint32_t wake = homing_deadline;
+	uint32_t timer_deadline;
+
+	if (timerWheelNextExpiry(&app_timers, &timer_deadline) &&
+			(!timed || (int32_t)(timer_deadline - wake) < 0))
+	{
+		timed = 1;
+		wake = timer_deadline;
+	}
+
+	// Nothing here is finer than the 1 ms tick: sleep until SysTick or a
+	// switch EXTI unless something is due again right away
+	if (!timed || (int32_t)(wake - HAL_GetTick()) > 0)
+	{
+		__WFI();
+	}
 }
 
 
@@ -3,6 +3,13 @@
 #include "pinConfig.h"
 #include "ton.h"
 #include "edge_detection.h"
+#include "timer_wheel.h"
+#include "gesture.h"
+#include "profile.h"
+#include "loop_monitor.h"
+#include "cdc_tx.h"
+#include "fmt.h"
+#include "string.h"
 #include "systemtick.h"
 #include "steady_clock.h"
 #include "MXADC.h"
@@ -30,6 +37,13 @@
 #define BTN_COUNT 	4
 #define BUTTONS 	BTN01, BTN02, BTN03, BTN04
 
+// Print into an LCD zone width characters wide, a longer value shows as dashes
+#define LCD_PRINT(zone, width, ...) \
+	do { char lcd_buf[(width) + 2]; \
+		if (fmtFormat(lcd_buf, sizeof(lcd_buf), __VA_ARGS__) > (width)) \
+			{ memset(lcd_buf, '-', (width)); lcd_buf[(width)] = '\0'; } \
+		lcdPutString((zone), lcd_buf); } while (0)
+
 static void deviceTestRun(void);
 static void setRtcByTimeLib(uint32_t year, uint32_t month, uint32_t day, uint32_t hour, uint32_t minute, uint32_t second);
 
@@ -77,9 +91,45 @@ static void handleErrBlink(uint8_t blink_state);
 void cleanUps(void);
 
 
-static edge_detection_t ed_onoff,ed_onoff_long, ed_plus, ed_minus, ed_menu, ed_child_lock_long;
-static edge_detection_t ed_menu_falling;
-static edge_detection_t ed_plus_long, ed_minus_long, ed_menu_long, ed_btn_device_on;
+// Bit of each button in the packed state, 1 = pressed
+#define BTN_BIT_1		(1UL << 0)
+#define BTN_BIT_2		(1UL << 1)
+#define BTN_BIT_3		(1UL << 2)
+#define BTN_BIT_4		(1UL << 3)
+
+enum {BTN_PRESSED_TIMEOUT = 75, ONOFF_LONG_TIMEOUT = 1000, BTN_LONG_TIMEOUT = 1000, 
+MENU_LONG_TIMEOUT = 1000, BTN_DEVICE_ON_TIMEOUT = 350, BTN_CHILD_LOCK_TIMEOUT = 2000,
+BTN_REPEAT_PERIOD = 50,};//ms
+
+enum
+{
+	BTN_GESTURE_ONOFF, BTN_GESTURE_ONOFF_LONG, BTN_GESTURE_DEVICE_ON,
+	BTN_GESTURE_PLUS, BTN_GESTURE_PLUS_LONG, BTN_GESTURE_PLUS_REPEAT,
+	BTN_GESTURE_MINUS, BTN_GESTURE_MINUS_LONG, BTN_GESTURE_MINUS_REPEAT,
+	BTN_GESTURE_MENU, BTN_GESTURE_MENU_RELEASE, BTN_GESTURE_MENU_LONG,
+	BTN_GESTURE_CHILD_LOCK_LONG,
+	BTN_GESTURE_COUNT
+};
+
+// Times count from the first sample of the chord, long ones include the press time
+static const gesture_def_t btn_gesture_table[BTN_GESTURE_COUNT] =
+{
+	[BTN_GESTURE_ONOFF]				= {BTN_BIT_1, BTN_PRESSED_TIMEOUT, 0, GESTURE_PRESS},
+	[BTN_GESTURE_ONOFF_LONG]		= {BTN_BIT_1, BTN_PRESSED_TIMEOUT + ONOFF_LONG_TIMEOUT, 0, GESTURE_PRESS},
+	[BTN_GESTURE_DEVICE_ON]			= {BTN_BIT_1, BTN_PRESSED_TIMEOUT + BTN_DEVICE_ON_TIMEOUT, 0, GESTURE_PRESS},
+	[BTN_GESTURE_PLUS]				= {BTN_BIT_3, BTN_PRESSED_TIMEOUT, 0, GESTURE_PRESS},
+	[BTN_GESTURE_PLUS_LONG]			= {BTN_BIT_3, BTN_PRESSED_TIMEOUT + BTN_LONG_TIMEOUT, 0, GESTURE_PRESS},
+	[BTN_GESTURE_PLUS_REPEAT]		= {BTN_BIT_3, BTN_PRESSED_TIMEOUT + BTN_LONG_TIMEOUT, BTN_REPEAT_PERIOD, GESTURE_REPEAT},
+	[BTN_GESTURE_MINUS]				= {BTN_BIT_2, BTN_PRESSED_TIMEOUT, 0, GESTURE_PRESS},
+	[BTN_GESTURE_MINUS_LONG]		= {BTN_BIT_2, BTN_PRESSED_TIMEOUT + BTN_LONG_TIMEOUT, 0, GESTURE_PRESS},
+	[BTN_GESTURE_MINUS_REPEAT]		= {BTN_BIT_2, BTN_PRESSED_TIMEOUT + BTN_LONG_TIMEOUT, BTN_REPEAT_PERIOD, GESTURE_REPEAT},
+	[BTN_GESTURE_MENU]				= {BTN_BIT_4, BTN_PRESSED_TIMEOUT, 0, GESTURE_PRESS},
+	[BTN_GESTURE_MENU_RELEASE]		= {BTN_BIT_4, BTN_PRESSED_TIMEOUT, 0, GESTURE_RELEASE},
+	[BTN_GESTURE_MENU_LONG]			= {BTN_BIT_4, BTN_PRESSED_TIMEOUT + MENU_LONG_TIMEOUT, 0, GESTURE_PRESS},
+	[BTN_GESTURE_CHILD_LOCK_LONG]	= {BTN_BIT_1 | BTN_BIT_4, BTN_PRESSED_TIMEOUT + BTN_CHILD_LOCK_TIMEOUT, 0, GESTURE_PRESS},
+};
+
+static gesture_t btn_gestures;
 
 
 static edge_detection_t ed_mainscreen_op_cleanup;
@@ -92,15 +142,14 @@ static edge_detection_t ed_menu_navigation_cleanup;
 static edge_detection_t ed_menu_temp_ctrl_sel_cleanup;
 static edge_detection_t ed_menu_wifi_settings_cleanup;
 
-static ton_t ton_onoff,ton_plus,ton_minus,ton_menu, ton_btn_device_on, ton_child_lock, ton_child_lock_pressed;
-static ton_t ton_onoff_pressed, ton_plus_pressed, ton_minus_pressed, ton_menu_pressed, ton_touched;
+static ton_t ton_touched;
 
-static uint8_t btn_onoff, btn_onoff_long, btn_onoff_pulse, btn_onoff_long_pulse;
-static uint8_t btn_plus, btn_plus_long, btn_plus_pulse, btn_plus_long_pulse;
-static uint8_t btn_minus, btn_minus_long, btn_minus_pulse, btn_minus_long_pulse;
-static uint8_t btn_menu, btn_menu_long, btn_menu_pulse, btn_menu_long_pulse;
-static uint8_t btn_device_on, btn_device_on_pulse, anybutton_backlight;
-static uint8_t btn_child_lock, btn_child_lock_long, btn_child_lock_long_pulse;
+static uint8_t btn_onoff_pulse, btn_onoff_long_pulse;
+static uint8_t btn_plus_long, btn_plus_pulse, btn_plus_long_pulse, btn_plus_repeat;
+static uint8_t btn_minus_long, btn_minus_pulse, btn_minus_long_pulse, btn_minus_repeat;
+static uint8_t btn_menu_long, btn_menu_pulse, btn_menu_long_pulse;
+static uint8_t btn_device_on_pulse, anybutton_backlight;
+static uint8_t btn_child_lock_long_pulse;
 static uint8_t btn_menu_pulse_falling;
 
 static uint8_t ir_onoff_pressed, ir_onoff_pulse, ir_plus_pulse, ir_minus_pulse, ir_plus_pressed, ir_minus_pressed, ir_repeat;
@@ -183,6 +232,13 @@ static uint32_t getSysTick(void)
     return systick;
 }
 
+// dev_data.homing_calib is restored by deviceModuleStart() with the other flash params
+static void saveCalibration(const homing_calib_t *calib)
+{
+	dev_data.homing_calib = *calib;
+	flashManagerMarkDirty(homing_calib.id);
+}
+
 
 static homing_t homing_obj;
 
@@ -191,7 +247,8 @@ static const homing_funcs_t homing_funcs =
     .setActuatorDirection = setActuatorDirection,
     .readRetractSwitch = readRetractSwitch,
     .readExtendSwitch = readExtendSwitch,
-    .getSysTick = getSysTick
+    .getSysTick = getSysTick,
+    .saveCalibration = saveCalibration
 };
 
 static ton_t ton_btn_startstop;
@@ -201,64 +258,89 @@ static ton_t ton_blink;
 
 static uint8_t blink;
 
+static timer_wheel_t app_timers;
+static loop_monitor_t loop_monitor;
+static wheel_timer_t blink_timer, blink2_timer, blink3_timer, blink_btn_timer;
+
 
 void runOne(void)
 {
+	steadyClockEnable();
+	cdcTxInit();
 	deviceModuleStart();
 	buzzerInit();
 
 	homingInit(&homing_obj, &homing_funcs);
+	homingLoadCalibration(&homing_obj, &dev_data.homing_calib);
+
+	gestureInit(&btn_gestures, btn_gesture_table, BTN_GESTURE_COUNT);
+	loopMonitorInit(&loop_monitor, LOOP_MONITOR_BUDGET_US);
+
+	timerWheelInit(&app_timers, systick);
+	timerWheelStart(&app_timers, &blink_btn_timer, 50, 50);
+	timerWheelStart(&app_timers, &blink3_timer, MAINSCREEN_REFRESH_TIMEOUT - 50, MAINSCREEN_REFRESH_TIMEOUT - 50);
+	timerWheelStart(&app_timers, &blink_timer, 100, 100);
+	timerWheelStart(&app_timers, &blink2_timer, 250, 0);
 }
 
 
 void run(void)
 {
-	static ton_t ton_blink, ton_blink2, ton_blink3, ton_btn, ton_btn2;
+	static ton_t ton_btn2;
 	static uint8_t blink_state, blink_state_pulse,blink_state2, blink_state3_pulse; 
 	static uint8_t blink_btn_pulse, blink_adc_pulse, reserve[2];
 	
-	static edge_detection_t ed_blink, ed_blink_btn, ed_blink3;
+	static edge_detection_t ed_blink;
 	
-	enum {BTN_PRESSED_TIMEOUT = 75, ONOFF_LONG_TIMEOUT = 1000, BTN_LONG_TIMEOUT = 1000, 
-	MENU_LONG_TIMEOUT = 1000, BTN_DEVICE_ON_TIMEOUT = 350, BTN_CHILD_LOCK_TIMEOUT = 2000,};//ms
+	// No steadyClockTick() in this board's SysTick handler, the loop keeps
+	// the CYCCNT extension going (needs a pass at least every ~12 s)
+	steadyClockTick();
+	loopMonitorBegin(&loop_monitor, steadyClockUsec(), (uint8_t)state);
+	timerWheelAdvance(&app_timers, systick);
+	cdcTxPoll();
+
+	uint32_t btn_state = (BTN01 ? 0 : BTN_BIT_1) | (BTN02 ? 0 : BTN_BIT_2)
+			| (BTN03 ? 0 : BTN_BIT_3) | (BTN04 ? 0 : BTN_BIT_4);
+	gestureProcess(&btn_gestures, btn_state, systick);
+	
+	// Pulses last one pass, like the edge detectors they replace
+	uint8_t btn_event[BTN_GESTURE_COUNT] = {0};
+	gesture_event_t gesture_event;
+	
+	while (gesturePop(&btn_gestures, &gesture_event))
+	{
+		btn_event[gesture_event.id] = 1;
+	}
 	
-	btn_onoff = !BTN01 && BTN02 && BTN03 && BTN04;
-	btn_onoff = TON(&ton_onoff_pressed, btn_onoff, systick, BTN_PRESSED_TIMEOUT);
-	btn_onoff_long = TON(&ton_onoff, btn_onoff, systick, ONOFF_LONG_TIMEOUT);
-	btn_onoff_pulse = edgeDetection(&ed_onoff, btn_onoff);
-	btn_onoff_long_pulse = edgeDetection(&ed_onoff_long, btn_onoff_long);
-	btn_device_on = TON(&ton_btn_device_on, btn_onoff, systick, BTN_DEVICE_ON_TIMEOUT);
-	btn_device_on_pulse = edgeDetection(&ed_btn_device_on, btn_device_on);
+	btn_onoff_pulse = btn_event[BTN_GESTURE_ONOFF];
+	btn_onoff_long_pulse = btn_event[BTN_GESTURE_ONOFF_LONG];
+	btn_device_on_pulse = btn_event[BTN_GESTURE_DEVICE_ON];
 	
-	btn_plus  = BTN01 && BTN02 && !BTN03 && BTN04;
-	btn_plus = TON(&ton_plus_pressed, btn_plus, systick, BTN_PRESSED_TIMEOUT);
-	btn_plus_long = TON(&ton_plus, btn_plus, systick, BTN_LONG_TIMEOUT);
-	btn_plus_pulse = edgeDetection(&ed_plus, btn_plus);
-	btn_plus_long_pulse = edgeDetection(&ed_plus_long, btn_plus_long);
+	btn_plus_pulse = btn_event[BTN_GESTURE_PLUS];
+	btn_plus_long_pulse = btn_event[BTN_GESTURE_PLUS_LONG];
+	btn_plus_repeat = btn_event[BTN_GESTURE_PLUS_REPEAT];
+	btn_plus_long = gestureIsActive(&btn_gestures, BTN_GESTURE_PLUS_LONG);
 	
-	btn_minus  = BTN01 && !BTN02 && BTN03 && BTN04;
-	btn_minus = TON(&ton_minus_pressed, btn_minus, systick, BTN_PRESSED_TIMEOUT);
-	btn_minus_long = TON(&ton_minus, btn_minus, systick, BTN_LONG_TIMEOUT);
-	btn_minus_pulse = edgeDetection(&ed_minus, btn_minus);
-	btn_minus_long_pulse = edgeDetection(&ed_minus_long, btn_minus_long);
+	btn_minus_pulse = btn_event[BTN_GESTURE_MINUS];
+	btn_minus_long_pulse = btn_event[BTN_GESTURE_MINUS_LONG];
+	btn_minus_repeat = btn_event[BTN_GESTURE_MINUS_REPEAT];
+	btn_minus_long = gestureIsActive(&btn_gestures, BTN_GESTURE_MINUS_LONG);
 	
-	btn_menu  = BTN01 && BTN02 && BTN03 && !BTN04;
-	btn_menu = TON(&ton_menu_pressed, btn_menu, systick, BTN_PRESSED_TIMEOUT);
-	btn_menu_long = TON(&ton_menu, btn_menu, systick, MENU_LONG_TIMEOUT);
-	btn_menu_pulse = edgeDetection(&ed_menu, btn_menu);
-	btn_menu_pulse_falling = edgeDetection(&ed_menu_falling, !btn_menu);
-	btn_menu_long_pulse = edgeDetection(&ed_menu_long, btn_menu_long);
+	btn_menu_pulse = btn_event[BTN_GESTURE_MENU];
+	btn_menu_pulse_falling = btn_event[BTN_GESTURE_MENU_RELEASE];
+	btn_menu_long_pulse = btn_event[BTN_GESTURE_MENU_LONG];
+	btn_menu_long = gestureIsActive(&btn_gestures, BTN_GESTURE_MENU_LONG);
 	
-	btn_child_lock = !BTN01 && BTN02 && BTN03 && !BTN04;
-	btn_child_lock = TON(&ton_child_lock_pressed, btn_child_lock, systick, BTN_PRESSED_TIMEOUT);
-	btn_child_lock_long = TON(&ton_child_lock, btn_child_lock, systick, BTN_CHILD_LOCK_TIMEOUT);
-	btn_child_lock_long_pulse = edgeDetection(&ed_child_lock_long, btn_child_lock_long);
+	btn_child_lock_long_pulse = btn_event[BTN_GESTURE_CHILD_LOCK_LONG];
 	
 	
 	if(btn_onoff_pulse && !homingIsActive(&homing_obj))
-		{homingStart(&homing_obj);}
+		{homingStartWarm(&homing_obj);}
 		
+	{
+		PROFILE_SCOPE("homingProcess");
 		homingProcess(&homing_obj);
+	}
 
 	if (homingIsActive(&homing_obj))
 	{
@@ -282,36 +364,29 @@ void run(void)
 	
 	// Blinkler ve Blink Pulse'lar(Pulse olanlar sonraki sart saglanana dek, bir kez 1 olur sonraki dngde 0. 
 	
-	if (TON(&ton_btn, 1, systick, 50))
-	{
-		TON(&ton_btn, 0, 0, 0);
-		blink_btn_pulse = !blink_btn_pulse; 
-	}
-	blink_btn_pulse = edgeDetection(&ed_blink_btn, blink_btn_pulse);
+	blink_btn_pulse = timerWheelExpired(&blink_btn_timer);
 
+	blink_state3_pulse = timerWheelExpired(&blink3_timer);
 	
-	if (TON(&ton_blink3, 1, systick, MAINSCREEN_REFRESH_TIMEOUT - 50))
+	if (timerWheelExpired(&blink_timer))
 	{
-		TON(&ton_blink3, 0, 0, 0);
-		blink_state3_pulse = !blink_state3_pulse; 
-	}
-	blink_state3_pulse = edgeDetection(&ed_blink3, blink_state3_pulse);
-	
-	
-	if (TON(&ton_blink, 1, systick, 100))
-	{
-		TON(&ton_blink, 0, 0, 0);
 		blink_state = !blink_state; 
 	}
 	blink_state_pulse =  edgeDetection(&ed_blink, blink_state);
 	
-	if (TON(&ton_blink2, 1, systick, blink_state2 ? 750 : 250))
+	if (timerWheelExpired(&blink2_timer))
 	{
-		TON(&ton_blink2, 0, 0, 0);
 		blink_state2 = !blink_state2;
+		timerWheelStart(&app_timers, &blink2_timer, blink_state2 ? 750 : 250, 0);
 	}
 	
+	loop_sample_t overrun;
 	
+	loopMonitorEnd(&loop_monitor, steadyClockUsec());
+	if (loopMonitorTakeOverrun(&loop_monitor, &overrun))
+	{
+		sendRf("LOOP_OVERRUN:%lu,%u\n", (unsigned long)overrun.exec_us, overrun.tag);
+	}
 }
 
 
@@ -507,6 +582,7 @@ void updateNtcErr(float current_temp)
 	
 static void handleRfCommands(char* data)
 {
+	PROFILE_SCOPE("handleRfCommands");
     bool retval = 0;
 	char cmd[30];
     char params[30];
@@ -602,6 +678,18 @@ static void handleRfCommands(char* data)
 		dev_data.err = 0;
 		//playBuzzerOK();
 	}
+	else if (strcmp(cmd, "PROFILE") == 0)
+	{
+		// PROFILE:DUMP prints the probe table over USB CDC, PROFILE:RESET clears it
+		if (strcmp(params, "RESET") == 0) {profileReset();}
+		else {profileDump();}
+	}
+	else if (strcmp(cmd, "LOOP") == 0)
+	{
+		// LOOP:DUMP prints the loop monitor over USB CDC, LOOP:RESET starts it over
+		if (strcmp(params, "RESET") == 0) {loopMonitorInit(&loop_monitor, loop_monitor.budget_us);}
+		else {loopMonitorDump(&loop_monitor);}
+	}
 }
 
 
@@ -736,13 +824,10 @@ static void handleOffOp(void)
 
 static void printTimeAndDayOfWeek(void)
 {
-	char buf[3];   // max 2 basamak + null
 	time_t now = time(NULL);
 	struct tm *lt = localtime(&now);
-	sprintf(buf, "%02d", lt->tm_hour); 
-	lcdPutString(ZONE_DIGIT1_DIGIT, buf);
-	sprintf(buf, "%02d", lt->tm_min); 
-	lcdPutString(ZONE_DIGIT3_DIGIT, buf);
+	LCD_PRINT(ZONE_DIGIT1_DIGIT, 2, "%02d", lt->tm_hour);
+	LCD_PRINT(ZONE_DIGIT3_DIGIT, 2, "%02d", lt->tm_min);
 	lcdSetSymbol(day_symbol[lt->tm_wday], 1);
 	
 	for(uint8_t i = 0; i < 7; i++)
@@ -752,11 +837,8 @@ static void printTimeAndDayOfWeek(void)
 
 static void printTimeAndDayOfWeekByIdx(int h, int min, int wd)
 {
-	char buf[3];   // max 2 basamak + null
-	sprintf(buf, "%02d", h); 
-	lcdPutString(ZONE_DIGIT1_DIGIT, buf);
-	sprintf(buf, "%02d", min); 
-	lcdPutString(ZONE_DIGIT3_DIGIT, buf);
+	LCD_PRINT(ZONE_DIGIT1_DIGIT, 2, "%02d", h);
+	LCD_PRINT(ZONE_DIGIT3_DIGIT, 2, "%02d", min);
 	lcdSetSymbol(day_symbol[wd], 1);
 	
 	for(uint8_t i = 0; i < 7; i++)
@@ -797,28 +879,23 @@ static void menuRtcCleanUp(void)
 
 static void menuRtcHelperPrintCase(uint8_t case_, int y, int mon, int d, int wd, int h, int min)
 {
-	char buf[3];   // max 2 basamak + null
-	
 	switch(case_)
 		{
 			case MENU_RTC_YEAR:
 				// Yil bilgisini sabit birak
-				sprintf(buf, "%02d", y % 100); 
-				lcdPutString(ZONE_DIGIT5_DIGIT, buf);
+				LCD_PRINT(ZONE_DIGIT5_DIGIT, 2, "%02d", y % 100);
 				lcdPutChar(ZONE_DIGIT7_DIGIT, 'y');
 			break;
 			
 			case MENU_RTC_MONTH:
 				// Ay bilgisini sabit birak
-				sprintf(buf, "%02d", mon); 
-				lcdPutString(ZONE_DIGIT5_DIGIT, buf);
+				LCD_PRINT(ZONE_DIGIT5_DIGIT, 2, "%02d", mon);
 				lcdPutChar(ZONE_DIGIT7_DIGIT, 'n');
 			break;
 			
 			case MENU_RTC_DAY:
 				// Gn bilgisini sabit birak
-				sprintf(buf, "%02d", d); 
-				lcdPutString(ZONE_DIGIT5_DIGIT, buf);
+				LCD_PRINT(ZONE_DIGIT5_DIGIT, 2, "%02d", d);
 				lcdPutChar(ZONE_DIGIT7_DIGIT, 'd');
 				
 				// Haftanin gn semboln de sabit gster
@@ -829,12 +906,10 @@ static void menuRtcHelperPrintCase(uint8_t case_, int y, int mon, int d, int wd,
 			case MENU_RTC_MINUTE:
 				lcdSetSymbol(SYMBOL_COL, 1);
 				// Saat bilgisini sabit birak
-				sprintf(buf, "%02d", h); 
-				lcdPutString(ZONE_DIGIT1_DIGIT, buf);
+				LCD_PRINT(ZONE_DIGIT1_DIGIT, 2, "%02d", h);
 		
 				// Dakika bilgisini sabit birak
-				sprintf(buf, "%02d", min); 
-				lcdPutString(ZONE_DIGIT3_DIGIT, buf);
+				LCD_PRINT(ZONE_DIGIT3_DIGIT, 2, "%02d", min);
 			break;
 		}
 }
@@ -875,7 +950,6 @@ static void menuRtcHelperClearScreen(uint8_t case_, int wd)
 
 static void menuRtc(uint8_t blink_state, uint8_t blink_btn, uint8_t *time_idx, uint8_t *menu_idx)
 {
-	char buf[3];   // max 2 basamak + null
 	static int y,mon,d, wd,h,min;
 	uint8_t max_day;
 	time_t now = time(NULL);
@@ -903,37 +977,37 @@ static void menuRtc(uint8_t blink_state, uint8_t blink_btn, uint8_t *time_idx, u
 	{
 		case MENU_RTC_YEAR:
 
-			if(btn_plus_pulse || (btn_plus_long && blink_btn)) {y = (y == 2099) ? 2025 : (y + 1);}
-			else if (btn_minus_pulse || (btn_minus_long && blink_btn)) {y = (y == 2025) ? 2099 : (y - 1);}
+			if(btn_plus_pulse || btn_plus_repeat) {y = (y == 2099) ? 2025 : (y + 1);}
+			else if (btn_minus_pulse || btn_minus_repeat) {y = (y == 2025) ? 2099 : (y - 1);}
 			
 		break;
 			
 		case MENU_RTC_MONTH:
 						
-			if(btn_plus_pulse || (btn_plus_long && blink_btn)) 			{mon = (mon == 12) ? 1 : (mon + 1);}
-			else if (btn_minus_pulse || (btn_minus_long && blink_btn))  {mon = (mon == 1) ? 12 : (mon - 1);}
+			if(btn_plus_pulse || btn_plus_repeat) 			{mon = (mon == 12) ? 1 : (mon + 1);}
+			else if (btn_minus_pulse || btn_minus_repeat)  {mon = (mon == 1) ? 12 : (mon - 1);}
 	
 		break;
 		
 		case MENU_RTC_DAY:	
 			max_day = getDaysInMonth(y, mon);
 		
-			if(btn_plus_pulse || (btn_plus_long && blink_btn)) 			{d = (d == max_day) ? 1 : (d + 1);}
-			else if (btn_minus_pulse || (btn_minus_long && blink_btn))  {d = (d == 1) ? max_day : (d - 1);}	
+			if(btn_plus_pulse || btn_plus_repeat) 			{d = (d == max_day) ? 1 : (d + 1);}
+			else if (btn_minus_pulse || btn_minus_repeat)  {d = (d == 1) ? max_day : (d - 1);}	
 			
 		break;
 
 		case MENU_RTC_HOUR:
 				
-			if(btn_plus_pulse || (btn_plus_long && blink_btn)) 			{h = (h + 1) % 24;} 
-			else if (btn_minus_pulse || (btn_minus_long && blink_btn))  {h = (h == 0) ? 23 : (h - 1);}
+			if(btn_plus_pulse || btn_plus_repeat) 			{h = (h + 1) % 24;} 
+			else if (btn_minus_pulse || btn_minus_repeat)  {h = (h == 0) ? 23 : (h - 1);}
 				
 		break;
 			
 		case MENU_RTC_MINUTE:
 			
-			if(btn_plus_pulse || (btn_plus_long && blink_btn)) 			{min = (min+ 1) % 60;}
-			else if (btn_minus_pulse || (btn_minus_long && blink_btn))  {min = (min == 0) ? 59 : (min - 1);}
+			if(btn_plus_pulse || btn_plus_repeat) 			{min = (min+ 1) % 60;}
+			else if (btn_minus_pulse || btn_minus_repeat)  {min = (min == 0) ? 59 : (min - 1);}
 				
 		break;
 
@@ -1045,8 +1119,6 @@ void menuWeeklySchedule(uint8_t blink_state, uint8_t blink_btn, uint8_t *schedul
 	static uint8_t edit_hour = 0;          // Hangi saat editliyoruz (0-23)     
 	uint8_t *selected_day = &dev_data.weekly_sche_days;
 		
-	char buf[3];   // max 2 basamak + null
-	
 	if(edgeDetection(&ed_menu_weekly_sche_cleanup, 1)) 
 	{
 		LCD_SetAllPixels(0);
@@ -1057,8 +1129,7 @@ void menuWeeklySchedule(uint8_t blink_state, uint8_t blink_btn, uint8_t *schedul
 	{
 		case MENU_WEEKLY_SCH_DAY:
 			
-			sprintf(buf, "%02d", edit_hour);
-			lcdPutString(ZONE_DIGIT1_DIGIT, buf);
+			LCD_PRINT(ZONE_DIGIT1_DIGIT, 2, "%02d", edit_hour);
 			lcdPutString(ZONE_DIGIT3_DIGIT, "00");
 			
             // Plus/Minus ile gn seimi (0-8: SU-SAT, Weekdays, Weekend, entire days, weekly schedule canceled)
@@ -1089,8 +1160,8 @@ void menuWeeklySchedule(uint8_t blink_state, uint8_t blink_btn, uint8_t *schedul
 		case MENU_WEEKLY_SCH_HOUR:
 			
 			// Plus/Minus ile saat seimi
-			if(btn_plus_pulse || (btn_plus_long && blink_btn))  		edit_hour = (edit_hour + 1) % 24;
-			else if (btn_minus_pulse || (btn_minus_long && blink_btn)) 	edit_hour = (edit_hour == 0) ? 23 : (edit_hour - 1);
+			if(btn_plus_pulse || btn_plus_repeat)  		edit_hour = (edit_hour + 1) % 24;
+			else if (btn_minus_pulse || btn_minus_repeat) 	edit_hour = (edit_hour == 0) ? 23 : (edit_hour - 1);
 			/**************** Menu pulse ile mevcut saati set et BEGIN ****************/
 
 		
@@ -1156,16 +1227,13 @@ void menuWeeklySchedule(uint8_t blink_state, uint8_t blink_btn, uint8_t *schedul
 			
 			if(*selected_day != 10)
 			{
-				char str[4];
-				sprintf(buf, "%s", display_value? "ON " : "OFF");
-				lcdPutString(ZONE_DIGIT5_DIGIT, buf);
+				lcdPutString(ZONE_DIGIT5_DIGIT, display_value? "ON " : "OFF");
 			}
 			
 			// Saati blink ile gster
             if (blink_state) 
 			{
-                sprintf(buf, "%02d", edit_hour);
-                lcdPutString(ZONE_DIGIT1_DIGIT, buf);
+                LCD_PRINT(ZONE_DIGIT1_DIGIT, 2, "%02d", edit_hour);
 				lcdPutString(ZONE_DIGIT3_DIGIT, "00");
 				lcdSetSymbol(SYMBOL_COL, 1);
 			}
@@ -1272,9 +1340,7 @@ static void printMenuSelectionRtc(void)
 
 static void printMenuNumber(uint8_t menu_number)
 {
-	char buf[3];
-	sprintf(buf, "%02d", menu_number);
-	lcdPutString(ZONE_DIGIT5_DIGIT, buf);
+	LCD_PRINT(ZONE_DIGIT5_DIGIT, 2, "%02d", menu_number);
 }
 
 void menuNavigationCleanUp(void)
@@ -1437,18 +1503,25 @@ static void handleErrBlink(uint8_t blink_state)
 
 void sendRfTelemetryData(void)
 {
-	char buf[3];   // max 2 basamak + null
+	PROFILE_SCOPE("sendRfTelemetryData");
 	time_t now = time(NULL);
 	struct tm *lt = localtime(&now);
 	// %5.2f -> toplam 5 karakter ve virglden sonra 2 karakter. Yani xx.xx(5 karakter)
-	sendRf("ALL:%5.2f,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", dev_data.current_temp, dev_data.device_on, dev_data.is_heating_on, 
+	// Scaled once in single precision on the FPU, fmt only sees integers
+	float temp_x100 = dev_data.current_temp * 100.0f;
+	char temp[12];
+	char line[96];
+	fmtFixed(temp, sizeof(temp), (int32_t)(temp_x100 + ((temp_x100 < 0.0f) ? -0.5f : 0.5f)), 2);
+	fmtFormat(line, sizeof(line), "ALL:%5s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", temp, dev_data.device_on, dev_data.is_heating_on, 
 					dev_data.w, dev_data.r, dev_data.b, 
 					g_weekly_schedule.is_active, dev_data.child_lock, dev_data.mode, lt->tm_hour, lt->tm_min, 
 					lt->tm_wday, GET_ERR(ERR_FALLOVER), GET_ERR(ERR_NTC));
+	sendRf("%s", line);
 }
 
 static void handleMainScreenOp(uint8_t blink_state)
 {
+	PROFILE_SCOPE("handleMainScreenOp");
 	static ton_t ton_screen_refresh;
 	static ton_t ton_mqtt_err;
 	
@@ -1474,14 +1547,10 @@ static void handleMainScreenOp(uint8_t blink_state)
 	{
 		TON(&ton_screen_refresh, 0 ,0, 0);
 		
-		char buf[3];   // max 2 basamak + null
-		
-		sprintf(buf, "%d", (uint32_t)dev_data.current_temp); 
-		lcdPutString(ZONE_DIGIT5_DIGIT, buf);
+		LCD_PRINT(ZONE_DIGIT5_DIGIT, 2, "%lu", (unsigned long)dev_data.current_temp);
 		
 		uint8_t frac = (dev_data.current_temp - (uint32_t)dev_data.current_temp) * 10;
-		sprintf(buf, "%d", frac); 
-		lcdPutChar(ZONE_DIGIT7_DIGIT, buf[0]);
+		lcdPutChar(ZONE_DIGIT7_DIGIT, '0' + frac % 10);
 
 		printTimeAndDayOfWeek();			
 
@@ -1583,7 +1652,6 @@ static void handleTempSetPointOp(uint8_t blink_state, uint8_t blink_btn)
 	const float setpoint_step_ir = 0.5;
 	const float max = 35.0f;
 	const float min = 15.0f;
-	char buf[4];   // max 3 basamak + null
 	
 	// ilk giriste yapilacaklar
 	if(edgeDetection(&ed_temp_setpoint_op_cleanup, 1))
@@ -1595,8 +1663,8 @@ static void handleTempSetPointOp(uint8_t blink_state, uint8_t blink_btn)
 	/***************************************************************/
 
 	
-	if(btn_plus_pulse  || (btn_plus_long && blink_btn)) 			setpoint += setpoint_step;
-	else if (btn_minus_pulse || (btn_minus_long && blink_btn))		setpoint -= setpoint_step;
+	if(btn_plus_pulse  || btn_plus_repeat) 			setpoint += setpoint_step;
+	else if (btn_minus_pulse || btn_minus_repeat)		setpoint -= setpoint_step;
 	else if(ir_plus_pulse || (ir_repeat && ir_plus_pressed && blink_btn)) 		setpoint += setpoint_step_ir;
 	else if(ir_minus_pulse || (ir_repeat && ir_minus_pressed && blink_btn)) 	setpoint -= setpoint_step_ir;
 	
@@ -1613,8 +1681,7 @@ static void handleTempSetPointOp(uint8_t blink_state, uint8_t blink_btn)
 	if (blink_state)
 	{
 		uint32_t uval = setpoint * 10;
-		sprintf(buf, "%3d", uval );
-		lcdPutString(ZONE_DIGIT5_DIGIT, buf);
+		LCD_PRINT(ZONE_DIGIT5_DIGIT, 3, "%3lu", (unsigned long)uval);
 	}
 	else
 	{
@@ -1683,9 +1750,7 @@ static void deviceTestRun(void)
 							LCD_SetAllPixels(0);
 							one_time[0] = 0;
 						}
-						char buf[3];   // max 1 basamak + null
-						sprintf(buf, "b%d", i);
-						lcdPutString(ZONE_DIGIT5_DIGIT, buf);
+						LCD_PRINT(ZONE_DIGIT5_DIGIT, 2, "b%d", i);
 						//LCDLIB_PrintNumber(ZONE_DIGIT5_DIGIT, i);
 					}
 						
@@ -1699,14 +1764,10 @@ static void deviceTestRun(void)
 				lcdPutString(ZONE_DIGIT5_DIGIT, "  ");
 				
 				float fval = adc_getNTCvalue(0,0);
-				char buf[3];   // max 2 basamak + null
-				
-				sprintf(buf, "%d", (uint32_t)fval); 
-				lcdPutString(ZONE_DIGIT1_DIGIT, buf);
+				LCD_PRINT(ZONE_DIGIT1_DIGIT, 2, "%lu", (unsigned long)fval);
 				
 				fval = adc_getNTCvalue(1,0);
-				sprintf(buf, "%d", (uint32_t)fval);
-				lcdPutString(ZONE_DIGIT3_DIGIT, buf);
+				LCD_PRINT(ZONE_DIGIT3_DIGIT, 2, "%lu", (unsigned long)fval);
 
 				btn_pulse && (state = 3, 0);
 			
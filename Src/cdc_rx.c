@@ -0,0 +1,69 @@
+#include "cdc_rx.h"
+#include "rx_ring.h"
+#include "usbd_cdc_if.h"
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+static rx_ring_t cdc_rx_ring;
+static volatile uint8_t cdc_rx_stalled;     // endpoint left NAKing, ring was full
+
+
+/**
+ * \brief Call from CDC_Init_FS, the class arms the endpoint after it.
+ */
+void cdcRxStart(void)
+{
+    rxRingInit(&cdc_rx_ring);
+    cdc_rx_stalled = 0;
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, rxRingReserve(&cdc_rx_ring));
+}
+
+/**
+ * \brief Call from CDC_Receive_FS: keeps the packet in place and arms the
+ * endpoint for the next one, or leaves it NAKing while the ring is full.
+ */
+void cdcRxReceive(uint32_t len)
+{
+    rxRingCommit(&cdc_rx_ring, (uint16_t)len);
+
+    uint8_t *next = rxRingReserve(&cdc_rx_ring);
+
+    if (!next)
+    {
+        cdc_rx_stalled = 1;
+        return;
+    }
+
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, next);
+    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+}
+
+/**
+ * \brief Next received line, call from the main loop. The slice points into
+ * the ring and stays valid until the next call.
+ * \return 0 if no complete line has arrived yet
+ */
+uint8_t cdcRxGetLine(slice_t *line)
+{
+    uint8_t got = rxRingGetLine(&cdc_rx_ring, line);
+
+    // The endpoint is not armed while stalled, so nothing else touches it
+    if (cdc_rx_stalled)
+    {
+        uint8_t *next = rxRingReserve(&cdc_rx_ring);
+
+        if (next)
+        {
+            cdc_rx_stalled = 0;
+            USBD_CDC_SetRxBuffer(&hUsbDeviceFS, next);
+            USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+        }
+    }
+
+    return got;
+}
+
+uint32_t cdcRxGetLineDropCount(void)
+{
+    return rxRingGetLineDropCount(&cdc_rx_ring);
+}
@@ -0,0 +1,97 @@
+#include "cdc_tx.h"
+#include "tx_ring.h"
+#include "usbd_cdc_if.h"
+
+static tx_ring_t cdc_tx_ring;
+static uint8_t cdc_tx_packet[2][CDC_TX_PACKET];
+static uint8_t cdc_tx_index;
+static uint16_t cdc_tx_pending;     // filled but refused by the endpoint
+static volatile uint8_t cdc_tx_busy;    // a packet is in flight or being started
+
+/**
+ * \brief Start the next packet, only the owner of cdc_tx_busy calls this.
+ * The other buffer may still be read by the USB core, so fill this one.
+ */
+static void transmitNext(void)
+{
+    if (!cdc_tx_pending)
+    {
+        cdc_tx_index ^= 1U;
+        cdc_tx_pending = txRingRead(&cdc_tx_ring, cdc_tx_packet[cdc_tx_index], CDC_TX_PACKET);
+    }
+
+    if (cdc_tx_pending
+        && CDC_Transmit_FS(cdc_tx_packet[cdc_tx_index], cdc_tx_pending) == USBD_OK)
+    {
+        cdc_tx_pending = 0;
+        return;
+    }
+
+    // Empty, or the endpoint is busy: cdcTxPoll() retries the kept packet
+    __atomic_store_n(&cdc_tx_busy, 0U, __ATOMIC_RELEASE);
+}
+
+void cdcTxInit(void)
+{
+    txRingInit(&cdc_tx_ring);
+    cdc_tx_index = 0;
+    cdc_tx_pending = 0;
+    cdc_tx_busy = 0;
+}
+
+/**
+ * \brief Queue bytes from any context, never waits.
+ * \return 0 if the ring was full and the bytes were dropped
+ */
+uint8_t cdcTxWrite(const void *data, uint16_t len)
+{
+    return txRingWrite(&cdc_tx_ring, data, len);
+}
+
+uint16_t cdcTxGetFree(void)
+{
+    return txRingGetFree(&cdc_tx_ring);
+}
+
+/**
+ * \brief Call from the main loop: starts a transfer when the link is idle and
+ * handles the usb_tx_len flag if the complete callback still only sets it.
+ */
+void cdcTxPoll(void)
+{
+    if (usb_tx_len)
+    {
+        usb_tx_len = 0;
+        transmitNext();
+        return;
+    }
+
+    if (!cdc_tx_pending && txRingIsEmpty(&cdc_tx_ring))
+    {
+        return;
+    }
+
+    if (!__atomic_exchange_n(&cdc_tx_busy, 1U, __ATOMIC_ACQUIRE))
+    {
+        transmitNext();
+    }
+}
+
+/**
+ * \brief Call from CDC_TransmitCplt_FS, chains the next packet in the
+ * interrupt so the link stays busy while the main loop runs.
+ */
+void cdcTxComplete(void)
+{
+    transmitNext();
+}
+
+uint32_t cdcTxGetDropCount(void)
+{
+    return txRingGetDropCount(&cdc_tx_ring);
+}
+
+uint32_t cdcTxGetDropBytes(void)
+{
+    return txRingGetDropBytes(&cdc_tx_ring);
+}
@@ -0,0 +1,42 @@
+#include "debounce.h"
+
+/**
+ * \fn uint8_t debounce(debounce_t *obj, uint8_t in, uint32_t now, uint32_t preset_time)
+ * \brief On-delay debounce that also remembers when the confirmed run started.
+ * \param in - raw input
+ * \param now - system tick continuously running
+ * \param preset_time - input must stay high this long to be confirmed
+ * \return confirmed state, debounceGetEdgeTime() gives the raw edge behind it
+ */
+uint8_t debounce(debounce_t *obj, uint8_t in, uint32_t now, uint32_t preset_time)
+{
+	// Any drop restarts the TON, so the last raw edge is the first stable one
+	if (edgeDetection(&obj->ed_raw, in))
+	{
+		obj->edge_time = now;
+	}
+
+	obj->raw = in;
+	obj->state = TON(&obj->ton, in, now, preset_time);
+
+	return obj->state;
+}
+
+uint32_t debounceGetEdgeTime(const debounce_t *obj)
+{
+	return obj->edge_time;
+}
+
+// Raw input is high but not confirmed yet
+uint8_t debounceIsPending(const debounce_t *obj)
+{
+	return obj->raw && !obj->state;
+}
+
+void debounceReset(debounce_t *obj)
+{
+	obj->ton.aux = 0;
+	obj->ed_raw.aux = 0;
+	obj->raw = 0;
+	obj->state = 0;
+}
@@ -18,3 +18,12 @@ uint8_t edgeDetection(edge_detection_t *obj, uint8_t val)
 	}
 	return retval;
 }
+
+void edgeBankUpdate(edge_bank_t *bank, uint32_t inputs)
+{
+	uint32_t changed = inputs ^ bank->prev;
+
+	bank->rising = changed & inputs;
+	bank->falling = changed & ~inputs;
+	bank->prev = inputs;
+}
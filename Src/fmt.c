@@ -0,0 +1,426 @@
+#include "fmt.h"
+
+#define FLAG_LEFT                    0x01U
+#define FLAG_ZERO                    0x02U
+#define FLAG_PLUS                    0x04U
+#define FLAG_SPACE                   0x08U
+
+// Digits of a 64 bit value plus precision padding
+#define FMT_TEXT_MAX                 32
+
+typedef struct
+{
+    char *buf;
+    uint16_t size;
+    uint16_t len;
+} fmt_out_t;
+
+typedef struct
+{
+    uint8_t flags;
+    uint8_t length;     // 0 int, 'H' char, 'h' short, 'l' long, 'L' long long
+    uint16_t width;
+    int16_t precision;  // -1 when not given
+} fmt_spec_t;
+
+static const uint32_t pow10_table[FMT_FIXED_MAX_DECIMALS + 1] =
+{
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL
+};
+
+
+static void putChar(fmt_out_t *out, char c)
+{
+    // Keep the last byte for the terminator
+    if (out->len + 1U < out->size)
+    {
+        out->buf[out->len++] = c;
+    }
+}
+
+static void putRepeat(fmt_out_t *out, char c, uint16_t count)
+{
+    while (count--)
+    {
+        putChar(out, c);
+    }
+}
+
+/**
+ * \brief Write sign and text padded to the field width. Zero padding goes
+ * between the sign and the text.
+ */
+static void putField(fmt_out_t *out, const fmt_spec_t *spec, char sign,
+                     const char *text, uint16_t len)
+{
+    uint16_t total = (uint16_t)(len + (sign ? 1U : 0U));
+    uint16_t pad = (spec->width > total) ? (uint16_t)(spec->width - total) : 0;
+
+    if (!(spec->flags & (FLAG_LEFT | FLAG_ZERO)))
+    {
+        putRepeat(out, ' ', pad);
+    }
+
+    if (sign)
+    {
+        putChar(out, sign);
+    }
+
+    if ((spec->flags & (FLAG_LEFT | FLAG_ZERO)) == FLAG_ZERO)
+    {
+        putRepeat(out, '0', pad);
+    }
+
+    for (uint16_t i = 0; i < len; ++i)
+    {
+        putChar(out, text[i]);
+    }
+
+    if (spec->flags & FLAG_LEFT)
+    {
+        putRepeat(out, ' ', pad);
+    }
+}
+
+/**
+ * \brief Append the digits of value to text, at least min_digits of them.
+ * 32 bit division unless the value needs more.
+ * \return new length of text
+ */
+static uint16_t appendDigits(char *text, uint16_t len, unsigned long long value,
+                             uint8_t base, uint8_t upper, uint16_t min_digits)
+{
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char rev[24];
+    uint16_t n = 0;
+
+    while (value > 0xFFFFFFFFULL)
+    {
+        rev[n++] = digits[value % base];
+        value /= base;
+    }
+
+    uint32_t value32 = (uint32_t)value;
+
+    while (value32)
+    {
+        rev[n++] = digits[value32 % base];
+        value32 /= base;
+    }
+
+    while (n < min_digits && n < sizeof(rev))
+    {
+        rev[n++] = '0';
+    }
+
+    while (n)
+    {
+        text[len++] = rev[--n];
+    }
+
+    return len;
+}
+
+static char signChar(const fmt_spec_t *spec, uint8_t negative)
+{
+    if (negative)
+    {
+        return '-';
+    }
+
+    if (spec->flags & FLAG_PLUS)
+    {
+        return '+';
+    }
+
+    return (spec->flags & FLAG_SPACE) ? ' ' : 0;
+}
+
+static void putInteger(fmt_out_t *out, fmt_spec_t *spec, unsigned long long magnitude,
+                       uint8_t negative, uint8_t base, uint8_t upper)
+{
+    char text[FMT_TEXT_MAX];
+    uint16_t min_digits = 1;
+
+    if (spec->precision >= 0)
+    {
+        // An explicit precision turns zero padding off, %.0d prints 0 as nothing
+        spec->flags &= (uint8_t)~FLAG_ZERO;
+        min_digits = (uint16_t)spec->precision;
+    }
+
+    uint16_t len = appendDigits(text, 0, magnitude, base, upper, min_digits);
+
+    putField(out, spec, signChar(spec, negative), text, len);
+}
+
+static void putString(fmt_out_t *out, fmt_spec_t *spec, const char *str)
+{
+    uint16_t len = 0;
+
+    if (!str)
+    {
+        str = "(null)";
+    }
+
+    while (str[len] && (spec->precision < 0 || len < (uint16_t)spec->precision))
+    {
+        len++;
+    }
+
+    spec->flags &= (uint8_t)~FLAG_ZERO;
+    putField(out, spec, 0, str, len);
+}
+
+static long long takeSigned(const fmt_spec_t *spec, va_list *va)
+{
+    switch (spec->length)
+    {
+        case 'H': return (signed char)va_arg(*va, int);
+        case 'h': return (short)va_arg(*va, int);
+        case 'l': return va_arg(*va, long);
+        case 'L': return va_arg(*va, long long);
+        default:  return va_arg(*va, int);
+    }
+}
+
+static unsigned long long takeUnsigned(const fmt_spec_t *spec, va_list *va)
+{
+    switch (spec->length)
+    {
+        case 'H': return (unsigned char)va_arg(*va, unsigned int);
+        case 'h': return (unsigned short)va_arg(*va, unsigned int);
+        case 'l': return va_arg(*va, unsigned long);
+        case 'L': return va_arg(*va, unsigned long long);
+        default:  return va_arg(*va, unsigned int);
+    }
+}
+
+/**
+ * \brief Parse flags, width, precision and length after a '%'.
+ * \return format advanced to the conversion character
+ */
+static const char *parseSpec(const char *format, fmt_spec_t *spec, va_list *va)
+{
+    spec->flags = 0;
+    spec->length = 0;
+    spec->width = 0;
+    spec->precision = -1;
+
+    for (;; ++format)
+    {
+        if (*format == '-')      spec->flags |= FLAG_LEFT;
+        else if (*format == '0') spec->flags |= FLAG_ZERO;
+        else if (*format == '+') spec->flags |= FLAG_PLUS;
+        else if (*format == ' ') spec->flags |= FLAG_SPACE;
+        else break;
+    }
+
+    if (*format == '*')
+    {
+        int width = va_arg(*va, int);
+
+        if (width < 0)
+        {
+            spec->flags |= FLAG_LEFT;
+            width = -width;
+        }
+
+        spec->width = (uint16_t)width;
+        format++;
+    }
+    else
+    {
+        while (*format >= '0' && *format <= '9')
+        {
+            spec->width = (uint16_t)(spec->width * 10U + (uint16_t)(*format++ - '0'));
+        }
+    }
+
+    if (*format == '.')
+    {
+        format++;
+        spec->precision = 0;
+
+        if (*format == '*')
+        {
+            int precision = va_arg(*va, int);
+
+            spec->precision = (precision < 0) ? -1 : (int16_t)precision;
+            format++;
+        }
+        else
+        {
+            while (*format >= '0' && *format <= '9')
+            {
+                spec->precision = (int16_t)(spec->precision * 10 + (*format++ - '0'));
+            }
+        }
+
+        // Keep the digits inside the local text buffer
+        if (spec->precision > FMT_TEXT_MAX - 8)
+        {
+            spec->precision = FMT_TEXT_MAX - 8;
+        }
+    }
+
+    if (*format == 'h')
+    {
+        format++;
+        spec->length = 'h';
+
+        if (*format == 'h')
+        {
+            format++;
+            spec->length = 'H';
+        }
+    }
+    else if (*format == 'l')
+    {
+        format++;
+        spec->length = 'l';
+
+        if (*format == 'l')
+        {
+            format++;
+            spec->length = 'L';
+        }
+    }
+
+    return format;
+}
+
+uint16_t fmtFormat(char *buf, uint16_t size, const char *format, ...)
+{
+    va_list va;
+
+    va_start(va, format);
+    uint16_t len = fmtFormatV(buf, size, format, va);
+    va_end(va);
+
+    return len;
+}
+
+/**
+ * \brief Format into buf, cut to size - 1 characters and terminated.
+ * \return characters written, without the terminator
+ */
+uint16_t fmtFormatV(char *buf, uint16_t size, const char *format, va_list va)
+{
+    fmt_out_t out = {buf, size, 0};
+    fmt_spec_t spec;
+    va_list args;
+
+    if (!size)
+    {
+        return 0;
+    }
+
+    // A copy so it can be passed on by pointer on every ABI
+    va_copy(args, va);
+
+    while (*format)
+    {
+        if (*format != '%')
+        {
+            putChar(&out, *format++);
+            continue;
+        }
+
+        format = parseSpec(format + 1, &spec, &args);
+
+        switch (*format)
+        {
+            case 'd':
+            case 'i':
+            {
+                long long value = takeSigned(&spec, &args);
+                unsigned long long magnitude = (value < 0) ? 0ULL - (unsigned long long)value
+                                                           : (unsigned long long)value;
+
+                putInteger(&out, &spec, magnitude, value < 0, 10, 0);
+                break;
+            }
+
+            case 'u':
+                putInteger(&out, &spec, takeUnsigned(&spec, &args), 0, 10, 0);
+                break;
+
+            case 'x':
+            case 'X':
+                spec.flags &= (uint8_t)~(FLAG_PLUS | FLAG_SPACE);
+                putInteger(&out, &spec, takeUnsigned(&spec, &args), 0, 16, *format == 'X');
+                break;
+
+            case 'f':
+                // No floating point, and the arguments after the double
+                // cannot be found without taking it: mark it and stop
+                putChar(&out, '%');
+                putChar(&out, 'f');
+                va_end(args);
+                buf[out.len] = '\0';
+                return out.len;
+
+            case 'c':
+            {
+                char c = (char)va_arg(args, int);
+
+                spec.flags &= (uint8_t)~FLAG_ZERO;
+                putField(&out, &spec, 0, &c, 1);
+                break;
+            }
+
+            case 's':
+                putString(&out, &spec, va_arg(args, const char *));
+                break;
+
+            case '%':
+                putChar(&out, '%');
+                break;
+
+            case '\0':
+                // Lone '%' at the end
+                continue;
+
+            default:
+                // Not supported, shown as written
+                putChar(&out, '%');
+                putChar(&out, *format);
+                break;
+        }
+
+        format++;
+    }
+
+    va_end(args);
+    buf[out.len] = '\0';
+    return out.len;
+}
+
+/**
+ * \brief Render value / 10^decimals, e.g. 2250 with 2 decimals is "22.50",
+ * for use with %s. Integer only, the caller scales once.
+ * \return buf
+ */
+const char *fmtFixed(char *buf, uint16_t size, int32_t value, uint8_t decimals)
+{
+    uint32_t magnitude = (value < 0) ? 0U - (uint32_t)value : (uint32_t)value;
+
+    if (decimals > FMT_FIXED_MAX_DECIMALS)
+    {
+        decimals = FMT_FIXED_MAX_DECIMALS;
+    }
+
+    if (!decimals)
+    {
+        fmtFormat(buf, size, "%ld", (long)value);
+        return buf;
+    }
+
+    uint32_t scale = pow10_table[decimals];
+
+    fmtFormat(buf, size, "%s%lu.%0*lu", (value < 0) ? "-" : "", (unsigned long)(magnitude / scale),
+              (int)decimals, (unsigned long)(magnitude % scale));
+
+    return buf;
+}
@@ -0,0 +1,247 @@
+#include "gesture.h"
+#include "string.h"
+
+#define QUEUE_MASK (GESTURE_QUEUE_SIZE - 1)
+
+#if (GESTURE_QUEUE_SIZE & QUEUE_MASK) != 0
+#error "GESTURE_QUEUE_SIZE must be a power of two"
+#endif
+
+#define TIME_OVER(target,time) ((uint32_t)((time) - (target)) < 0x80000000U)
+
+static void chordMatched(gesture_t *g, uint8_t id, uint32_t now);
+static void chordReleased(gesture_t *g, uint8_t id, uint32_t now);
+static void holdDone(gesture_t *g, uint8_t id, uint32_t now);
+static void repeatDue(gesture_t *g, uint32_t now);
+static void emit(gesture_t *g, uint8_t id, uint32_t now);
+
+
+void gestureInit(gesture_t *g, const gesture_def_t *table, uint8_t count)
+{
+    memset((void *)g, 0, sizeof(gesture_t));
+
+    g->table = table;
+    g->count = count > GESTURE_MAX ? GESTURE_MAX : count;
+
+    tonBankInit(&g->holds);
+
+    for (uint8_t id = 0; id < g->count; ++id)
+    {
+        tonBankSetPreset(&g->holds, id, table[id].hold_ms);
+    }
+}
+
+/**
+ * \brief Feed the packed button state of this pass.
+ * \param state - bit per button, 1 = pressed, already debounced or raw
+ * \param now - system tick continuously running
+ */
+void gestureProcess(gesture_t *g, uint32_t state, uint32_t now)
+{
+    if (state != g->state)
+    {
+        uint32_t matched = 0;
+
+        g->state = state;
+
+        for (uint8_t id = 0; id < g->count; ++id)
+        {
+            if (g->table[id].chord == state)
+            {
+                matched |= 1UL << id;
+            }
+        }
+
+        g->matched = matched;
+    }
+
+    edgeBankUpdate(&g->edges, g->matched);
+
+    uint32_t changed = g->edges.rising | g->edges.falling;
+
+    while (changed)
+    {
+        uint8_t id = (uint8_t)__builtin_ctz(changed);
+        changed &= changed - 1;
+
+        if (EDGE_BANK_RISING(&g->edges, id))
+        {
+            chordMatched(g, id, now);
+        }
+        else
+        {
+            chordReleased(g, id, now);
+        }
+    }
+
+    uint32_t done = tonBankUpdate(&g->holds, g->holding, now) & g->holding;
+
+    while (done)
+    {
+        uint8_t id = (uint8_t)__builtin_ctz(done);
+        done &= done - 1;
+
+        holdDone(g, id, now);
+    }
+
+    if (g->repeating && TIME_OVER(g->next_due, now))
+    {
+        repeatDue(g, now);
+    }
+}
+
+uint8_t gesturePop(gesture_t *g, gesture_event_t *event)
+{
+    if (g->tail == g->head)
+    {
+        return 0;
+    }
+
+    *event = g->queue[g->tail];
+    g->tail = (uint8_t)((g->tail + 1) & QUEUE_MASK);
+    return 1;
+}
+
+// PRESS / REPEAT row has fired and its chord is still held
+uint8_t gestureIsActive(const gesture_t *g, uint8_t id)
+{
+    return id < g->count ? g->row[id].active : 0;
+}
+
+uint32_t gestureGetOverflowCount(const gesture_t *g)
+{
+    return g->overflow_count;
+}
+
+
+static void chordMatched(gesture_t *g, uint8_t id, uint32_t now)
+{
+    const gesture_def_t *def = &g->table[id];
+    gesture_row_t *row = &g->row[id];
+
+    // DOUBLE: too long since the first press was let go, start over
+    if (def->type == GESTURE_DOUBLE && row->count && (uint32_t)(now - row->since) > def->period_ms)
+    {
+        row->count = 0;
+    }
+
+    row->since = now;
+    row->active = 0;
+    g->holding |= 1UL << id;
+}
+
+static void chordReleased(gesture_t *g, uint8_t id, uint32_t now)
+{
+    const gesture_def_t *def = &g->table[id];
+    gesture_row_t *row = &g->row[id];
+    uint8_t held = !(g->holding & (1UL << id));     // hold_ms reached
+
+    if (def->type == GESTURE_RELEASE && held)
+    {
+        emit(g, id, now);
+    }
+    else if (def->type == GESTURE_DOUBLE && !held)
+    {
+        // Too short to count as a press
+        row->count = 0;
+    }
+
+    row->since = now;
+    row->active = 0;
+    g->holding &= ~(1UL << id);
+    g->repeating &= ~(1UL << id);
+}
+
+// The chord has been held for hold_ms
+static void holdDone(gesture_t *g, uint8_t id, uint32_t now)
+{
+    const gesture_def_t *def = &g->table[id];
+    gesture_row_t *row = &g->row[id];
+
+    g->holding &= ~(1UL << id);
+
+    switch (def->type)
+    {
+        case GESTURE_PRESS:
+            row->active = 1;
+            emit(g, id, now);
+            break;
+
+        case GESTURE_REPEAT:
+            row->active = 1;
+            emit(g, id, now);
+
+            if (def->period_ms)
+            {
+                row->next = now + def->period_ms;
+
+                if (!g->repeating || (int32_t)(row->next - g->next_due) < 0)
+                {
+                    g->next_due = row->next;
+                }
+
+                g->repeating |= 1UL << id;
+            }
+            break;
+
+        case GESTURE_DOUBLE:
+            if (++row->count >= 2)
+            {
+                row->count = 0;
+                emit(g, id, now);
+            }
+            break;
+
+        case GESTURE_RELEASE:
+        default:
+            // Qualified, the event goes out on release
+            break;
+    }
+}
+
+static void repeatDue(gesture_t *g, uint32_t now)
+{
+    uint32_t scan = g->repeating;
+    uint32_t next_due = now + 0x7FFFFFFFU;
+
+    while (scan)
+    {
+        uint8_t id = (uint8_t)__builtin_ctz(scan);
+        gesture_row_t *row = &g->row[id];
+
+        scan &= scan - 1;
+
+        if (TIME_OVER(row->next, now))
+        {
+            emit(g, id, now);
+            row->next += g->table[id].period_ms;
+
+            if (TIME_OVER(row->next, now))
+            {
+                row->next = now + g->table[id].period_ms;
+            }
+        }
+
+        if ((int32_t)(row->next - next_due) < 0)
+        {
+            next_due = row->next;
+        }
+    }
+
+    g->next_due = next_due;
+}
+
+static void emit(gesture_t *g, uint8_t id, uint32_t now)
+{
+    uint8_t next = (uint8_t)((g->head + 1) & QUEUE_MASK);
+
+    if (next == g->tail)
+    {
+        g->overflow_count++;
+        return;
+    }
+
+    g->queue[g->head].id = id;
+    g->queue[g->head].time = now;
+    g->head = next;
+}
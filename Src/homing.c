@@ -1,27 +1,60 @@
 #include "homing.h"
 #include "string.h"
-#include "stdio.h"
-
-static const homing_funcs_t *funcs_ptr = NULL;
 
+#define TIME_BEFORE(time,target) ((uint32_t)((target) - (time)) - 1U < 0x7FFFFFFFU)
 
 static void updateSwitchInputs(homing_t *homing, uint32_t current_time);
-static void setActuatorDirection(actuator_direction_t dir);
+static void traceSwitch(homing_t *homing, homing_switch_t which, uint8_t prev, uint8_t level, uint8_t debounced);
+static void setActuatorDirection(homing_t *homing, actuator_direction_t dir);
 static void transitionToError(homing_t *homing, homing_error_t error);
-static void stopActuator(void);
+static void stopActuator(homing_t *homing);
 static void resetAllTimers(homing_t *homing);
+static uint8_t hasEdgeCapture(const homing_t *homing);
+static void pollSwitchEdges(homing_t *homing);
+static void beginMeasure(homing_t *homing, homing_switch_t which);
+static uint32_t finishMeasure(homing_t *homing, homing_switch_t which, uint32_t elapsed_ms);
+static void dropRejectedEdge(homing_t *homing, const debounce_t *db);
+static void approachSwitch(homing_t *homing, const debounce_t *db, actuator_direction_t dir,
+                           uint32_t current_time);
+static uint8_t approachStep(homing_t *homing, uint8_t pulse, const debounce_t *db,
+                            actuator_direction_t dir, uint32_t current_time);
+static uint8_t approachProfiled(homing_t *homing, uint8_t pulse, const debounce_t *db,
+                                actuator_direction_t dir, uint32_t current_time);
+static uint8_t hasDutyControl(const homing_t *homing);
+static void driveAt(homing_t *homing, actuator_direction_t dir, uint8_t duty);
+static void driveStop(homing_t *homing);
+static void driveApply(homing_t *homing, actuator_direction_t dir);
+static void updateDrive(homing_t *homing, uint32_t current_time);
+static uint32_t centerMoveTime(const homing_t *homing);
+static uint32_t phaseTimeout(const homing_t *homing);
+static uint8_t settleDone(homing_t *homing, const debounce_t *db, uint32_t current_time);
+static uint8_t settleEarlyTime(const homing_t *homing, const debounce_t *db, uint32_t *end_time);
+static const debounce_t *settleSwitch(const homing_t *homing);
+static void considerDeadline(uint32_t candidate, uint32_t current_time, uint8_t *found, uint32_t *deadline);
+static uint32_t calibCheck(const homing_calib_t *calib);
+static uint32_t statCheck(const running_stat_t *stat);
 
 
 void homingInit(homing_t *homing, const homing_funcs_t *funcs)
 {
-	funcs_ptr = funcs;
-
     memset(homing, 0, sizeof(homing_t));
 
+    homing->funcs = funcs;
+
     homing->debounce_time_ms = HOMING_DEBOUNCE_TIME;
     homing->timeout_ms = HOMING_TIMEOUT;
     homing->settle_time_ms = HOMING_SETTLE_TIME;
+    homing->min_travel_time_ms = HOMING_MIN_TRAVEL_TIME;
     homing->retry_count = HOMING_RETRY_COUNT;
+    homing->stop_on_first_edge = HOMING_STOP_ON_FIRST_EDGE;
+
+    homing->profile.fast_duty = HOMING_FAST_DUTY;
+    homing->profile.slow_duty = HOMING_SLOW_DUTY;
+    homing->profile.backoff_ms = HOMING_BACKOFF_TIME;
+    homing->profile.ramp_ms = HOMING_RAMP_TIME;
+    homing->phase_timeout_ms = HOMING_TIMEOUT;
+
+    homingPositionInit(homing);
 
     homing->state = HOMING_STATE_IDLE;
     homing->is_homing_active = 0;
@@ -38,12 +71,18 @@ uint8_t homingStart(homing_t *homing)
 
     homing->state = HOMING_STATE_INIT;
     homing->error = HOMING_ERROR_NONE;
+    homing->position.is_moving = 0;
     homing->is_homing_active = 1;
     homing->is_homed = 0;
     homing->progress_percent = 0;
     homing->current_retry = 0;
     homing->extend_travel_time_ms = 0;
 	homing->retract_travel_time_ms = 0;
+    homing->extend_travel_time_us = 0;
+    homing->retract_travel_time_us = 0;
+    homing->warm_start = 0;
+    homing->approach_phase = HOMING_APPROACH_FAST;
+    homing->contact_seen = 0;
 
     resetAllTimers(homing);
 
@@ -51,28 +90,114 @@ uint8_t homingStart(homing_t *homing)
 }
 
 
+/**
+ * \brief Short homing with a valid stored calibration: drive to the retract
+ * switch only, check the travel is plausible, then go to the center using the
+ * stored extend time. Falls back to a full run if the check fails or there is
+ * no calibration.
+ */
+uint8_t homingStartWarm(homing_t *homing)
+{
+    if (!homingStart(homing))
+    {
+        return 0;
+    }
+
+    if (homing->calib_valid)
+    {
+        homing->warm_start = 1;
+    }
+
+    return 1;
+}
+
+
+uint8_t homingLoadCalibration(homing_t *homing, const homing_calib_t *calib)
+{
+    homing->calib_valid = (calib->magic == HOMING_CALIB_MAGIC) &&
+                          (calib->check == calibCheck(calib)) &&
+                          (calib->extend_travel_time_us != 0) &&
+                          (calib->retract_travel_time_us != 0) &&
+                          (calib->extend_travel_stat.count <= RUNNING_STAT_WINDOW) &&
+                          (calib->retract_travel_stat.count <= RUNNING_STAT_WINDOW);
+
+    if (homing->calib_valid)
+    {
+        // Seed the stroke statistics, the phase timeouts survive a power cycle
+        homing->calib = *calib;
+        homing->extend_travel_stat = calib->extend_travel_stat;
+        homing->retract_travel_stat = calib->retract_travel_stat;
+    }
+
+    return homing->calib_valid;
+}
+
+
+// Travel times of the last full run, 0 if there are none
+uint8_t homingGetCalibration(const homing_t *homing, homing_calib_t *calib)
+{
+    if (!homing->calib_valid)
+    {
+        return 0;
+    }
+
+    *calib = homing->calib;
+
+    return 1;
+}
+
+
 
 
 void homingProcess(homing_t *homing)
 {
-    if (!homing->is_homing_active)
+    if (!homing->is_homing_active && !homing->position.is_moving)
+    {
+        return;
+    }
+
+    homingProcessAt(homing, homing->funcs->getSysTick());
+}
+
+
+// Same as homingProcess but with the tick supplied by the caller, so a
+// group of axes can share one clock read per pass
+void homingProcessAt(homing_t *homing, uint32_t current_time)
+{
+    if (homing->position.is_moving)
     {
+        homingPositionProcess(homing, current_time);
         return;
     }
 
-    uint32_t current_time = funcs_ptr->getSysTick();
+    if (!homing->is_homing_active)
+    {
+        return;
+    }
 
     updateSwitchInputs(homing, current_time);
+    updateDrive(homing, current_time);
 
     uint8_t state_changed = (homing->state != homing->prevstate);
+
+    if (state_changed)
+    {
+        HOMING_TRACE_EVENT(homing, TRACE_HOMING_STATE, homing->state, homing->prevstate);
+    }
+
     homing->prevstate = homing->state;
 
+    if (state_changed)
+    {
+        homing->phase_timeout_ms = phaseTimeout(homing);
+    }
+
     uint8_t timeout_occurred = 0;
     if (homing->state >= HOMING_STATE_MOVE_TO_RETRACT_LIMIT &&
         homing->state <= HOMING_STATE_MOVE_TO_CENTER)
     {
         timeout_occurred = TON(&homing->ton_timeout, 1, current_time,
-                              homing->timeout_ms);
+                              homing->phase_timeout_ms);
 
         if (timeout_occurred)
         {
@@ -91,25 +216,38 @@ void homingProcess(homing_t *homing)
             homing->state = HOMING_STATE_MOVE_TO_RETRACT_LIMIT;
 
             homing->ton_timeout.aux = 0;
+            homing->approach_start_time = current_time;
 
-            setActuatorDirection(ACTUATOR_DIR_RETRACT);
-			#ifdef HOMING_DEBUG
-            if(state_changed)
-            	printf("HOMING_STATE_INIT\r\n");
-			#endif
+            setActuatorDirection(homing, ACTUATOR_DIR_RETRACT);
             break;
         }
 
         case HOMING_STATE_MOVE_TO_RETRACT_LIMIT:
         {
             homing->progress_percent = 15;
-            if(state_changed)
-				#ifdef HOMING_DEBUG
-            	printf("GOTO RETRACT SW\r\n");
-			#endif
-            if (homing->retract_switch_pulse)
+            uint8_t contact = approachStep(homing, homing->retract_switch_pulse,
+                                           &homing->db_retract_switch, ACTUATOR_DIR_RETRACT,
+                                           current_time);
+
+            if ((contact & HOMING_CONTACT_FIRST) && homing->warm_start)
             {
-                stopActuator();
+                // From anywhere in the stroke the retract switch must be
+                // reached within one calibrated stroke, else recalibrate
+                uint32_t travel_ms = debounceGetEdgeTime(&homing->db_retract_switch) -
+                                     homing->approach_start_time;
+                uint32_t limit_ms = homing->calib.retract_travel_time_us / 1000 *
+                                    (100 + HOMING_WARM_TOLERANCE_PCT) / 100;
+
+                if (travel_ms > limit_ms)
+                {
+                    homing->warm_start = 0;
+                    HOMING_TRACE_EVENT(homing, TRACE_HOMING_WARM_REJECT, 0, travel_ms);
+                }
+            }
+
+            if (contact & HOMING_CONTACT_FINAL)
+            {
+                stopActuator(homing);
                 homing->ton_settle.aux = 0;
                 homing->state = HOMING_STATE_SETTLE_AT_RETRACT;
             }
@@ -120,15 +258,27 @@ void homingProcess(homing_t *homing)
         {
             homing->progress_percent = 20;
 
-            if (TON(&homing->ton_settle, 1, current_time, homing->settle_time_ms))
+            if (settleDone(homing, &homing->db_retract_switch, current_time))
             {
+                if (homing->warm_start)
+                {
+                    // Skip the measuring strokes, center with the stored times
+                    homing->extend_travel_time_us = homing->calib.extend_travel_time_us;
+                    homing->retract_travel_time_us = homing->calib.retract_travel_time_us;
+                    homing->extend_travel_time_ms = homing->extend_travel_time_us / 1000;
+                    homing->retract_travel_time_ms = homing->retract_travel_time_us / 1000;
+                    homing->ton_timeout.aux = 0;
+                    homing->ton_center_move.aux = 0;
+                    homing->state = HOMING_STATE_MOVE_TO_CENTER;
+                    setActuatorDirection(homing, ACTUATOR_DIR_EXTEND);
+                    break;
+                }
+
                 homing->retract_limit_reached_time = current_time;
+                beginMeasure(homing, HOMING_SWITCH_EXTEND);
                 homing->ton_timeout.aux = 0;
                 homing->state = HOMING_STATE_MEASURE_EXTEND;
-                setActuatorDirection(ACTUATOR_DIR_EXTEND);
-				#ifdef HOMING_DEBUG
-                printf("HOMING_STATE_SETTLE_AT_RETRACT\r\n");
-				#endif
+                setActuatorDirection(homing, ACTUATOR_DIR_EXTEND);
             }
             break;
         }
@@ -136,23 +286,33 @@ void homingProcess(homing_t *homing)
         case HOMING_STATE_MEASURE_EXTEND:
         {
             homing->progress_percent = 40;
-			#ifdef HOMING_DEBUG
-            if(state_changed)
-				printf("GOTO EXTEND SW\r\n");
-			#endif
-            if (homing->extend_switch_pulse)
+            uint8_t contact = approachStep(homing, homing->extend_switch_pulse,
+                                           &homing->db_extend_switch, ACTUATOR_DIR_EXTEND,
+                                           current_time);
+
+            // Travel is measured on the fast contact, the slow one is the reference
+            if (contact & HOMING_CONTACT_FIRST)
             {
-                homing->extend_travel_time_ms = current_time - homing->retract_limit_reached_time;
+                // Measure to the contact, not to the end of the debounce window
+                uint32_t contact_time = debounceGetEdgeTime(&homing->db_extend_switch);
 
-                if (homing->extend_travel_time_ms < 100)
+                homing->extend_travel_time_us = finishMeasure(homing, HOMING_SWITCH_EXTEND,
+                                                              contact_time - homing->retract_limit_reached_time);
+                homing->extend_travel_time_ms = homing->extend_travel_time_us / 1000;
+
+                if (homing->extend_travel_time_ms < homing->min_travel_time_ms)
                 {
                     transitionToError(homing, HOMING_ERROR_INVALID_TRAVEL);
                     break;
                 }
-				#ifdef HOMING_DEBUG
-				printf("extend_travel_time_ms = %lu\r\n", homing->extend_travel_time_ms);
-				#endif
-                stopActuator();
+                runningStatAdd(&homing->extend_travel_stat, homing->extend_travel_time_ms);
+                HOMING_TRACE_EVENT(homing, TRACE_HOMING_TRAVEL, HOMING_SWITCH_EXTEND,
+                                   homing->extend_travel_time_us);
+            }
+
+            if (contact & HOMING_CONTACT_FINAL)
+            {
+                stopActuator(homing);
                 homing->ton_settle.aux = 0;
                 homing->state = HOMING_STATE_SETTLE_AT_EXTEND;
             }
@@ -163,16 +323,14 @@ void homingProcess(homing_t *homing)
         {
             homing->progress_percent = 50;
 
-            if (TON(&homing->ton_settle, 1, current_time, homing->settle_time_ms))
+            if (settleDone(homing, &homing->db_extend_switch, current_time))
             {
 				homing->extend_limit_reached_time = current_time;
+                beginMeasure(homing, HOMING_SWITCH_RETRACT);
                 homing->ton_timeout.aux = 0;
                 homing->ton_center_move.aux = 0;
                 homing->state = HOMING_STATE_MEASURE_RETRACT;
-                setActuatorDirection(ACTUATOR_DIR_RETRACT);
-				#ifdef HOMING_DEBUG
-                printf("HOMING_STATE_SETTLE_AT_EXTEND\r\n");
-				#endif
+                setActuatorDirection(homing, ACTUATOR_DIR_RETRACT);
             }
             break;
         }
@@ -181,24 +339,32 @@ void homingProcess(homing_t *homing)
 		case HOMING_STATE_MEASURE_RETRACT:
         {                
             homing->progress_percent = 60;
-            #ifdef HOMING_DEBUG
-			if (state_changed)
-                printf("GOTO RETRACT SW\r\n");
-			#endif
-            if (homing->retract_switch_pulse)
+            uint8_t contact = approachStep(homing, homing->retract_switch_pulse,
+                                           &homing->db_retract_switch, ACTUATOR_DIR_RETRACT,
+                                           current_time);
+
+            if (contact & HOMING_CONTACT_FIRST)
             {
+                uint32_t contact_time = debounceGetEdgeTime(&homing->db_retract_switch);
+
+                homing->retract_travel_time_us = finishMeasure(homing, HOMING_SWITCH_RETRACT,
+                                                               contact_time - homing->extend_limit_reached_time);
+                homing->retract_travel_time_ms = homing->retract_travel_time_us / 1000;
+                HOMING_TRACE_EVENT(homing, TRACE_HOMING_TRAVEL, HOMING_SWITCH_RETRACT,
+                                   homing->retract_travel_time_us);
 
-                homing->retract_travel_time_ms = current_time - homing->extend_limit_reached_time;
-                #ifdef HOMING_DEBUG
-                printf("retract_travel_time_ms = %lu\r\n", homing->retract_travel_time_ms);
-				#endif
-                if (homing->retract_travel_time_ms < 100)
+                if (homing->retract_travel_time_ms < homing->min_travel_time_ms)
                 {
                     transitionToError(homing, HOMING_ERROR_INVALID_TRAVEL);
                     break;
                 }
 
-                stopActuator();
+                runningStatAdd(&homing->retract_travel_stat, homing->retract_travel_time_ms);
+            }
+
+            if (contact & HOMING_CONTACT_FINAL)
+            {
+                stopActuator(homing);
                 homing->ton_settle.aux = 0;
                 homing->state = HOMING_STATE_SETTLE_AT_RETRACT_2;
             }
@@ -210,15 +376,12 @@ void homingProcess(homing_t *homing)
             homing->progress_percent = 70;
 
             // Settle süresini bekle
-            if (TON(&homing->ton_settle, 1, current_time, homing->settle_time_ms))
+            if (settleDone(homing, &homing->db_retract_switch, current_time))
             {
                 homing->ton_timeout.aux = 0;
                 homing->ton_center_move.aux = 0;
                 homing->state = HOMING_STATE_MOVE_TO_CENTER;
-                setActuatorDirection(ACTUATOR_DIR_EXTEND);
-				#ifdef HOMING_DEBUG
-				printf("HOMING_STATE_SETTLE_AT_RETRACT_2\r\n");
-				#endif
+                setActuatorDirection(homing, ACTUATOR_DIR_EXTEND);
             }
             break;
         }
@@ -226,12 +389,13 @@ void homingProcess(homing_t *homing)
 		case HOMING_STATE_MOVE_TO_CENTER:
         {
             //Extend yönünde ölçülen sürenin yarısı kadar git
-            uint32_t half_extend_time = homing->extend_travel_time_ms / 2;
+            uint32_t half_extend_time = centerMoveTime(homing);
 
             //Progress hesaplama
             if (half_extend_time > 0 && homing->ton_center_move.aux)
             {
-                uint32_t elapsed = current_time - homing->ton_center_move.since;
+                // since holds the end of the move
+                uint32_t elapsed = half_extend_time - (homing->ton_center_move.since - current_time);
                 uint32_t progress_range = (elapsed * 25) / half_extend_time;
                 homing->progress_percent = 70 + (uint8_t)progress_range;
 				
@@ -244,53 +408,65 @@ void homingProcess(homing_t *homing)
             //Extend yönünde yarı yolu bekle
             if (TON(&homing->ton_center_move, 1, current_time, half_extend_time))
             {
-                stopActuator();
+                stopActuator(homing);
                 homing->state = HOMING_STATE_COMPLETE;
                 homing->is_homed = 1;
                 homing->progress_percent = 100;
-				#ifdef HOMING_DEBUG
-                printf("NOW AT CENTER POSITION!\r\n");
-                printf("Extend time: %lu ms, Retract time: %lu ms\r\n", 
-                      homing->extend_travel_time_ms, 
-                      homing->retract_travel_time_ms);
-				printf("spped ratio(E/R): %f\r\n",homing->extend_travel_time_ms / (float)homing->retract_travel_time_ms);
-				
-				float extend_velocity = ACTUATOR_STROKE_MM  / (float)homing->extend_travel_time_ms;
-				float retract_velocity = ACTUATOR_STROKE_MM / (float)homing->retract_travel_time_ms;
+                homingPositionCalibrate(homing);
+                homingKinematicsUpdate(homing);
 
-				printf("Extend speed: %f m/s\r\n", extend_velocity);
-				printf("Retract speed: %f m/s\r\n", retract_velocity);
-				#endif
+                if (!homing->warm_start)
+                {
+                    homing->calib.magic = HOMING_CALIB_MAGIC;
+                    homing->calib.extend_travel_time_us = homing->extend_travel_time_us;
+                    homing->calib.retract_travel_time_us = homing->retract_travel_time_us;
+                    homing->calib.extend_travel_stat = homing->extend_travel_stat;
+                    homing->calib.retract_travel_stat = homing->retract_travel_stat;
+                    homing->calib.check = calibCheck(&homing->calib);
+                    homing->calib_valid = 1;
+
+                    if (homing->funcs->saveCalibration)
+                    {
+                        homing->funcs->saveCalibration(&homing->calib);
+                    }
+                }
+                // One record per stroke, a packed pair would not fit strokes over 65 s
+                HOMING_TRACE_EVENT(homing, TRACE_HOMING_COMPLETE,
+                                   (uint16_t)(HOMING_SWITCH_EXTEND | (homing->warm_start << 8)),
+                                   homing->extend_travel_time_ms);
+                HOMING_TRACE_EVENT(homing, TRACE_HOMING_COMPLETE,
+                                   (uint16_t)(HOMING_SWITCH_RETRACT | (homing->warm_start << 8)),
+                                   homing->retract_travel_time_ms);
 				
             }
             break;
         }
 
+        case HOMING_STATE_LEARN:
+        {
+            homingLearnProcess(homing, current_time);
+            break;
+        }
+
         case HOMING_STATE_COMPLETE:
         {
             homing->is_homing_active = 0;
-			#ifdef HOMING_DEBUG
-            if(state_changed)
-				printf("COMPLETED\r\n");
-			#endif
             break;
         }
 
         case HOMING_STATE_ERROR:
         {
-            stopActuator();
-			#ifdef HOMING_DEBUG
-            printf("ERROR\r\n");
-			#endif
+            stopActuator(homing);
             //Retry
             if (homing->current_retry < homing->retry_count)
             {
                 homing->current_retry++;
-				#ifdef HOMING_DEBUG
-				printf("Retry %d/%d\r\n", homing->current_retry, homing->retry_count);
-				#endif
+                HOMING_TRACE_EVENT(homing, TRACE_HOMING_RETRY, homing->current_retry,
+                                   homing->retry_count);
                 homing->state = HOMING_STATE_INIT;
                 homing->error = HOMING_ERROR_NONE;
+                homing->warm_start = 0;
+                homing->approach_phase = HOMING_APPROACH_FAST;
                 resetAllTimers(homing);
             }
             else
@@ -312,9 +488,139 @@ void homingProcess(homing_t *homing)
 
 
 
+/**
+ * \brief Event driven entry point. Run one pass for a wake-up (switch edge
+ * interrupt or an expired deadline) and report when the next pass is due.
+ * Between deadlines only a switch edge can change anything, so the caller may
+ * sleep until the deadline or the next interrupt.
+ * \param deadline - absolute tick of the next pass, valid when 1 is returned
+ * \return 0 when nothing is timed, i.e. idle or only waiting for an input
+ */
+uint8_t homingProcessEvent(homing_t *homing, uint32_t current_time, uint32_t *deadline)
+{
+    homingProcessAt(homing, current_time);
+
+    return homingNextDeadline(homing, current_time, deadline);
+}
+
+
+uint8_t homingNextDeadline(const homing_t *homing, uint32_t current_time, uint32_t *deadline)
+{
+    uint8_t found = 0;
+    uint32_t end_time;
+
+    if (homing->position.is_moving)
+    {
+        if (homing->position.start_pending)
+        {
+            considerDeadline(homing->position.move_start_time, current_time, &found, deadline);
+        }
+
+        considerDeadline(homing->position.move_start_time + homing->position.move_duration_ms,
+                         current_time, &found, deadline);
+        return found;
+    }
+
+    if (!homing->is_homing_active)
+    {
+        return 0;
+    }
+
+    // New states do their entry work on the next pass
+    if (homing->state != homing->prevstate || homing->state == HOMING_STATE_COMPLETE ||
+        homing->state == HOMING_STATE_ERROR)
+    {
+        *deadline = current_time;
+        return 1;
+    }
+
+    if (homing->state == HOMING_STATE_LEARN)
+    {
+        return homingLearnDeadline(homing, deadline);
+    }
+
+    if (homing->ton_timeout.aux)
+    {
+        considerDeadline(homing->ton_timeout.since, current_time, &found, deadline);
+    }
+
+    // Contacts waiting to be confirmed
+    if (debounceIsPending(&homing->db_retract_switch))
+    {
+        considerDeadline(homing->db_retract_switch.ton.since, current_time, &found, deadline);
+    }
+
+    if (debounceIsPending(&homing->db_extend_switch))
+    {
+        considerDeadline(homing->db_extend_switch.ton.since, current_time, &found, deadline);
+    }
+
+    // Early stop once a held raw contact is confirmed
+    if (homing->stop_on_first_edge && homing->actuator_dir != ACTUATOR_DIR_STOP)
+    {
+        if (debounceIsPending(&homing->db_retract_switch))
+        {
+            considerDeadline(debounceGetEdgeTime(&homing->db_retract_switch) + HOMING_STOP_CONFIRM_TIME,
+                             current_time, &found, deadline);
+        }
+
+        if (debounceIsPending(&homing->db_extend_switch))
+        {
+            considerDeadline(debounceGetEdgeTime(&homing->db_extend_switch) + HOMING_STOP_CONFIRM_TIME,
+                             current_time, &found, deadline);
+        }
+    }
+
+    if (settleSwitch(homing) && homing->ton_settle.aux)
+    {
+        considerDeadline(homing->ton_settle.since, current_time, &found, deadline);
+
+        if (settleEarlyTime(homing, settleSwitch(homing), &end_time))
+        {
+            considerDeadline(end_time, current_time, &found, deadline);
+        }
+    }
+
+    if (homing->approach_phase == HOMING_APPROACH_BACKOFF)
+    {
+        considerDeadline(homing->approach_phase_time + homing->profile.backoff_ms,
+                         current_time, &found, deadline);
+    }
+
+    if (homing->state == HOMING_STATE_MOVE_TO_CENTER && homing->ton_center_move.aux)
+    {
+        considerDeadline(homing->ton_center_move.since, current_time, &found, deadline);
+
+        // Deceleration ramp is stepped every tick
+        if (hasDutyControl(homing))
+        {
+            considerDeadline(homing->ton_center_move.since - homing->profile.ramp_ms,
+                             current_time + 1, &found, deadline);
+        }
+    }
+
+    // Acceleration ramp is stepped every tick
+    if (hasDutyControl(homing) && homing->actuator_dir != ACTUATOR_DIR_STOP &&
+        homing->drive_duty != homing->drive_target_duty)
+    {
+        considerDeadline(current_time + 1, current_time, &found, deadline);
+    }
+
+    return found;
+}
+
+
+// Record state changes, switch edges, actuator commands and errors into trace
+void homingSetTrace(homing_t *homing, trace_t *trace, uint8_t id)
+{
+    homing->trace = trace;
+    homing->trace_id = id;
+}
+
 void homingAbort(homing_t *homing)
 {
-    stopActuator();
+    stopActuator(homing);
+    homing->position.is_moving = 0;
     homing->state = HOMING_STATE_IDLE;
     homing->is_homing_active = 0;
     homing->is_homed = 0;
@@ -351,21 +657,27 @@ homing_state_t homingGetState(const homing_t *homing)
 
 static void updateSwitchInputs(homing_t *homing, uint32_t current_time)
 {
+    uint8_t retract_raw = homing->retract_switch_raw;
+    uint8_t extend_raw = homing->extend_switch_raw;
+    uint8_t retract_debounced = homing->retract_switch_debounced;
+    uint8_t extend_debounced = homing->extend_switch_debounced;
+
+    pollSwitchEdges(homing);
+
     // Read raw switch states from hardware
-    homing->retract_switch_raw = funcs_ptr->readRetractSwitch();
-    homing->extend_switch_raw = funcs_ptr->readExtendSwitch();
+    homing->retract_switch_raw = homing->funcs->readRetractSwitch();
+    homing->extend_switch_raw = homing->funcs->readExtendSwitch();
 
-    // Debounce retract switch with TON
-    homing->retract_switch_debounced = TON(&homing->ton_retract_switch,
-                                           homing->retract_switch_raw,
-                                           current_time,
-                                           homing->debounce_time_ms);
+    // Debounce switches, the raw contact time is kept for the measurements
+    homing->retract_switch_debounced = debounce(&homing->db_retract_switch,
+                                                homing->retract_switch_raw,
+                                                current_time,
+                                                homing->debounce_time_ms);
 
-    // Debounce extend switch with TON
-    homing->extend_switch_debounced = TON(&homing->ton_extend_switch,
-                                          homing->extend_switch_raw,
-                                          current_time,
-                                          homing->debounce_time_ms);
+    homing->extend_switch_debounced = debounce(&homing->db_extend_switch,
+                                               homing->extend_switch_raw,
+                                               current_time,
+                                               homing->debounce_time_ms);
 
     // Detect rising edges (0->1 transition detection)
     homing->retract_switch_pulse = edgeDetection(&homing->ed_retract_switch,
@@ -373,34 +685,87 @@ static void updateSwitchInputs(homing_t *homing, uint32_t current_time)
 
     homing->extend_switch_pulse = edgeDetection(&homing->ed_extend_switch,
                                                        homing->extend_switch_debounced);
+
+    if (homing->trace)
+    {
+        traceSwitch(homing, HOMING_SWITCH_RETRACT, retract_raw, homing->retract_switch_raw, 0);
+        traceSwitch(homing, HOMING_SWITCH_EXTEND, extend_raw, homing->extend_switch_raw, 0);
+        traceSwitch(homing, HOMING_SWITCH_RETRACT, retract_debounced, homing->retract_switch_debounced, 1);
+        traceSwitch(homing, HOMING_SWITCH_EXTEND, extend_debounced, homing->extend_switch_debounced, 1);
+    }
 }
 
-static void setActuatorDirection(actuator_direction_t dir)
+static void traceSwitch(homing_t *homing, homing_switch_t which, uint8_t prev, uint8_t level, uint8_t debounced)
 {
-    if (funcs_ptr && funcs_ptr->setActuatorDirection)
+    if (prev != level)
     {
-        funcs_ptr->setActuatorDirection(dir);
+        HOMING_TRACE_EVENT(homing, TRACE_HOMING_SWITCH, (uint16_t)(which | (level << 8)), debounced);
     }
 }
 
+static void setActuatorDirection(homing_t *homing, actuator_direction_t dir)
+{
+    driveAt(homing, dir, homing->profile.fast_duty);
+}
 
-static void stopActuator(void)
+// Direction now, duty is ramped towards the target by updateDrive()
+static void driveAt(homing_t *homing, actuator_direction_t dir, uint8_t duty)
 {
-    setActuatorDirection(ACTUATOR_DIR_STOP);
+    if (dir != homing->actuator_dir)
+    {
+        homing->drive_ramp_restart = 1;
+    }
+
+    homing->drive_target_duty = duty;
+    driveApply(homing, dir);
+}
+
+// Stop without touching the target duty, a resume carries on at the same speed
+static void driveStop(homing_t *homing)
+{
+    driveApply(homing, ACTUATOR_DIR_STOP);
+}
+
+static void driveApply(homing_t *homing, actuator_direction_t dir)
+{
+    homing->actuator_dir = dir;
+
+    HOMING_TRACE_EVENT(homing, TRACE_HOMING_ACTUATOR, dir,
+                       (dir == ACTUATOR_DIR_STOP) ? 0 : homing->drive_target_duty);
+
+    if (dir == ACTUATOR_DIR_STOP && hasDutyControl(homing))
+    {
+        homing->drive_duty = 0;
+        homing->funcs->setActuatorDuty(0);
+    }
+
+    if (homing->funcs && homing->funcs->setActuatorDirection)
+    {
+        homing->funcs->setActuatorDirection(dir);
+    }
+}
+
+
+static void stopActuator(homing_t *homing)
+{
+    driveStop(homing);
 }
 
 static void transitionToError(homing_t *homing, homing_error_t error)
 {
-    stopActuator();
+    stopActuator(homing);
     homing->error = error;
     homing->state = HOMING_STATE_ERROR;
+
+    HOMING_TRACE_EVENT(homing, TRACE_HOMING_ERROR, error, 0);
 }
 
 static void resetAllTimers(homing_t *homing)
 {
+    debounceReset(&homing->db_retract_switch);
+    debounceReset(&homing->db_extend_switch);
+
     // Reset all TON timer auxiliary variables
-    homing->ton_retract_switch.aux = 0;
-    homing->ton_extend_switch.aux = 0;
     homing->ton_timeout.aux = 0;
     homing->ton_settle.aux = 0;
     homing->ton_center_move.aux = 0;
@@ -409,3 +774,484 @@ static void resetAllTimers(homing_t *homing)
     homing->ed_retract_switch.aux = 0;
     homing->ed_extend_switch.aux = 0;
 }
+
+static uint8_t hasEdgeCapture(const homing_t *homing)
+{
+    return homing->funcs->getMicros && homing->funcs->armSwitchEdge &&
+           homing->funcs->popSwitchEdge;
+}
+
+// Keep the latest captured edge per switch, debounced pulses still drive the states
+static void pollSwitchEdges(homing_t *homing)
+{
+    homing_switch_edge_t edge;
+
+    if (!hasEdgeCapture(homing))
+    {
+        return;
+    }
+
+    while (homing->funcs->popSwitchEdge(&edge))
+    {
+        if (edge.which == HOMING_SWITCH_RETRACT)
+        {
+            homing->retract_edge_us = edge.timestamp_us;
+            homing->retract_edge_paused_ms = homing->paused_ms;
+            homing->retract_edge_valid = 1;
+        }
+        else
+        {
+            homing->extend_edge_us = edge.timestamp_us;
+            homing->extend_edge_paused_ms = homing->paused_ms;
+            homing->extend_edge_valid = 1;
+        }
+    }
+}
+
+// Called right before the actuator starts towards switch "which"
+static void beginMeasure(homing_t *homing, homing_switch_t which)
+{
+    homing->paused_ms = 0;
+
+    if (!hasEdgeCapture(homing))
+    {
+        return;
+    }
+
+    pollSwitchEdges(homing);
+
+    if (which == HOMING_SWITCH_RETRACT)
+    {
+        homing->retract_edge_valid = 0;
+    }
+    else
+    {
+        homing->extend_edge_valid = 0;
+    }
+
+    homing->funcs->armSwitchEdge(which);
+    homing->measure_start_us = homing->funcs->getMicros();
+}
+
+/**
+ * \brief Travel time of the move started by beginMeasure(), early stops on
+ * rejected contacts taken out. Only the stops before the captured edge count,
+ * a stop after it is not part of that travel.
+ * \param elapsed_ms - tick based time to the contact, stops included, used
+ * when no edge was captured or the captured one does not add up
+ * \return travel time in us
+ */
+static uint32_t finishMeasure(homing_t *homing, homing_switch_t which, uint32_t elapsed_ms)
+{
+    if (hasEdgeCapture(homing))
+    {
+        uint8_t valid = (which == HOMING_SWITCH_RETRACT) ? homing->retract_edge_valid : homing->extend_edge_valid;
+        uint32_t edge_us = (which == HOMING_SWITCH_RETRACT) ? homing->retract_edge_us : homing->extend_edge_us;
+        uint32_t paused_ms = (which == HOMING_SWITCH_RETRACT) ? homing->retract_edge_paused_ms :
+                                                                homing->extend_edge_paused_ms;
+        uint32_t travel_us = edge_us - homing->measure_start_us;
+
+        // Never wrap, a stop longer than the travel falls back to the ticks
+        if (valid && travel_us > paused_ms * 1000U)
+        {
+            return travel_us - paused_ms * 1000U;
+        }
+    }
+
+    // Clamped, a zero travel is rejected as HOMING_ERROR_INVALID_TRAVEL
+    return (elapsed_ms > homing->paused_ms) ? (elapsed_ms - homing->paused_ms) * 1000U : 0;
+}
+
+/**
+ * \brief The capture keeps only the first raw edge. Once the debounce has
+ * dropped that contact it was a glitch: forget it and arm for the next edge,
+ * else the real contact is never captured and the stroke measures short.
+ */
+static void dropRejectedEdge(homing_t *homing, const debounce_t *db)
+{
+    if (!hasEdgeCapture(homing) || db->raw || db->state)
+    {
+        return;
+    }
+
+    if (db == &homing->db_retract_switch)
+    {
+        if (homing->retract_edge_valid)
+        {
+            homing->retract_edge_valid = 0;
+            homing->funcs->armSwitchEdge(HOMING_SWITCH_RETRACT);
+        }
+    }
+    else if (homing->extend_edge_valid)
+    {
+        homing->extend_edge_valid = 0;
+        homing->funcs->armSwitchEdge(HOMING_SWITCH_EXTEND);
+    }
+}
+
+/**
+ * \brief Stop once a raw contact has been held for HOMING_STOP_CONFIRM_TIME,
+ * drive on again if the debounce rejects it. A single glitch sample does not
+ * stop the actuator, and the time spent stopped is not counted as travel.
+ */
+static void approachSwitch(homing_t *homing, const debounce_t *db, actuator_direction_t dir,
+                           uint32_t current_time)
+{
+    if (!homing->stop_on_first_edge)
+    {
+        return;
+    }
+
+    if (debounceIsPending(db))
+    {
+        if (homing->actuator_dir != ACTUATOR_DIR_STOP &&
+            current_time - debounceGetEdgeTime(db) >= HOMING_STOP_CONFIRM_TIME)
+        {
+            stopActuator(homing);
+            homing->pause_start_time = current_time;
+        }
+    }
+    else if (!db->state && homing->actuator_dir == ACTUATOR_DIR_STOP)
+    {
+        // Same stroke, the ramp carries on from where it was
+        homing->paused_ms += current_time - homing->pause_start_time;
+        driveApply(homing, dir);
+    }
+}
+
+/**
+ * \brief Approach a limit switch, fast then back off and touch off slowly
+ * when a duty callback is bound.
+ * \return HOMING_CONTACT_FIRST on the fast contact, HOMING_CONTACT_FINAL on
+ * the slow one. Both at once for single speed drives.
+ */
+static uint8_t approachStep(homing_t *homing, uint8_t pulse, const debounce_t *db,
+                            actuator_direction_t dir, uint32_t current_time)
+{
+    uint8_t contact = 0;
+
+    // Only the measuring strokes are captured, on the first contact
+    if ((homing->state == HOMING_STATE_MEASURE_EXTEND || homing->state == HOMING_STATE_MEASURE_RETRACT) &&
+        homing->approach_phase == HOMING_APPROACH_FAST)
+    {
+        dropRejectedEdge(homing, db);
+    }
+
+    if (db->raw && !homing->contact_seen && homing->approach_phase != HOMING_APPROACH_BACKOFF)
+    {
+        homing->contact_seen = 1;
+        homing->first_contact_time = current_time;
+    }
+
+    if (!hasDutyControl(homing))
+    {
+        approachSwitch(homing, db, dir, current_time);
+        contact = pulse ? (HOMING_CONTACT_FIRST | HOMING_CONTACT_FINAL) : 0;
+    }
+    else
+    {
+        contact = approachProfiled(homing, pulse, db, dir, current_time);
+    }
+
+    // How long the switch chattered before it stayed closed
+    if (contact & HOMING_CONTACT_FINAL)
+    {
+        runningStatAdd(&homing->bounce_stat, debounceGetEdgeTime(db) - homing->first_contact_time);
+        homing->contact_seen = 0;
+    }
+
+    return contact;
+}
+
+static uint8_t approachProfiled(homing_t *homing, uint8_t pulse, const debounce_t *db,
+                                actuator_direction_t dir, uint32_t current_time)
+{
+    uint8_t contact = 0;
+
+    switch (homing->approach_phase)
+    {
+        case HOMING_APPROACH_FAST:
+        {
+            approachSwitch(homing, db, dir, current_time);
+
+            if (pulse)
+            {
+                contact = HOMING_CONTACT_FIRST;
+                homing->approach_phase = HOMING_APPROACH_BACKOFF;
+                homing->approach_phase_time = current_time;
+                driveAt(homing, (dir == ACTUATOR_DIR_EXTEND) ? ACTUATOR_DIR_RETRACT : ACTUATOR_DIR_EXTEND,
+                        homing->profile.slow_duty);
+            }
+            break;
+        }
+
+        case HOMING_APPROACH_BACKOFF:
+        {
+            // Back off for the preset time and until the switch is released
+            if (!db->raw && (current_time - homing->approach_phase_time) >= homing->profile.backoff_ms)
+            {
+                homing->approach_phase = HOMING_APPROACH_SLOW;
+                homing->contact_seen = 0;
+                driveAt(homing, dir, homing->profile.slow_duty);
+            }
+            break;
+        }
+
+        case HOMING_APPROACH_SLOW:
+        default:
+        {
+            approachSwitch(homing, db, dir, current_time);
+
+            if (pulse)
+            {
+                contact = HOMING_CONTACT_FINAL;
+                homing->approach_phase = HOMING_APPROACH_FAST;
+            }
+            break;
+        }
+    }
+
+    return contact;
+}
+
+static uint8_t hasDutyControl(const homing_t *homing)
+{
+    return homing->funcs && homing->funcs->setActuatorDuty;
+}
+
+// Acceleration ramp after every start, deceleration ramp at the end of the center move
+static void updateDrive(homing_t *homing, uint32_t current_time)
+{
+    // Learning passes drive like positioning moves, without ramps
+    if (!hasDutyControl(homing) || homing->actuator_dir == ACTUATOR_DIR_STOP ||
+        homing->state == HOMING_STATE_LEARN)
+    {
+        return;
+    }
+
+    if (homing->drive_ramp_restart)
+    {
+        homing->drive_ramp_restart = 0;
+        homing->drive_start_time = current_time;
+    }
+
+    uint32_t duty = homing->drive_target_duty;
+    uint32_t ramp_ms = homing->profile.ramp_ms;
+
+    // The learned table was taken without ramps
+    if (homing->state == HOMING_STATE_MOVE_TO_CENTER && homing->motion.valid)
+    {
+        ramp_ms = 0;
+    }
+
+    if (ramp_ms)
+    {
+        uint32_t accel_duty = ((current_time - homing->drive_start_time) * 100U) / ramp_ms;
+
+        if (accel_duty < duty)
+        {
+            duty = accel_duty;
+        }
+
+        if (homing->state == HOMING_STATE_MOVE_TO_CENTER && homing->ton_center_move.aux &&
+            TIME_BEFORE(current_time, homing->ton_center_move.since))
+        {
+            uint32_t decel_duty = ((homing->ton_center_move.since - current_time) * 100U) / ramp_ms;
+
+            if (decel_duty < duty)
+            {
+                duty = decel_duty;
+            }
+        }
+    }
+
+    if (duty != homing->drive_duty)
+    {
+        homing->drive_duty = (uint8_t)duty;
+        homing->funcs->setActuatorDuty((uint8_t)duty);
+    }
+}
+
+// Time a ramp from standstill takes to reach the fast duty
+uint32_t homingRampTime(const homing_t *homing)
+{
+    if (!hasDutyControl(homing))
+    {
+        return 0;
+    }
+
+    return ((uint32_t)homing->profile.ramp_ms * homing->profile.fast_duty) / 100U;
+}
+
+/**
+ * \brief Duration of the move from the retract limit to the center.
+ * The measured stroke lost half a ramp while accelerating, the center move
+ * loses half a ramp on each end. A learned motion table replaces both.
+ */
+static uint32_t centerMoveTime(const homing_t *homing)
+{
+    if (homing->motion.valid)
+    {
+        return homingMotionTime(homing, HOMING_MOTION_EXTEND, HOMING_POSITION_FULL / 2);
+    }
+
+    uint32_t ramp = homingRampTime(homing);
+
+    if (!ramp)
+    {
+        return homing->extend_travel_time_ms / 2;
+    }
+
+    return (homing->extend_travel_time_ms - ramp / 2) / 2 + ramp;
+}
+
+static uint32_t calibCheck(const homing_calib_t *calib)
+{
+    return ~(calib->magic ^ calib->extend_travel_time_us ^
+             (calib->retract_travel_time_us << 1) ^
+             statCheck(&calib->extend_travel_stat) ^
+             (statCheck(&calib->retract_travel_stat) << 3));
+}
+
+static uint32_t statCheck(const running_stat_t *stat)
+{
+    return (stat->count << 24) ^ stat->sum ^
+           (uint32_t)stat->sum_sq ^ ((uint32_t)(stat->sum_sq >> 32) << 1);
+}
+
+/**
+ * \brief Timeout of the phase that has just been entered. Once enough runs
+ * are recorded the stroke gets the larger of HOMING_TIMEOUT_SLACK_PCT of its
+ * mean and HOMING_TIMEOUT_SIGMA * sigma, sigma floored at
+ * HOMING_TIMEOUT_SIGMA_MIN, plus the fixed parts of the phase. A retry runs
+ * with timeout_ms, so a drive that has slowed down can still home and teach
+ * the new strokes.
+ */
+static uint32_t phaseTimeout(const homing_t *homing)
+{
+    const running_stat_t *stat;
+    uint32_t expected;
+
+    if (homing->current_retry)
+    {
+        return homing->timeout_ms;
+    }
+
+    switch (homing->state)
+    {
+        case HOMING_STATE_MOVE_TO_RETRACT_LIMIT:
+        case HOMING_STATE_MEASURE_RETRACT:
+            stat = &homing->retract_travel_stat;
+            break;
+
+        // The center move is planned from the extend stroke
+        case HOMING_STATE_MEASURE_EXTEND:
+        case HOMING_STATE_MOVE_TO_CENTER:
+            stat = &homing->extend_travel_stat;
+            break;
+
+        default:
+            return homing->timeout_ms;
+    }
+
+    if (runningStatCount(stat) < HOMING_STATS_MIN_SAMPLES)
+    {
+        return homing->timeout_ms;
+    }
+
+    expected = (homing->state == HOMING_STATE_MOVE_TO_CENTER) ? centerMoveTime(homing) :
+                                                                 runningStatMean(stat);
+
+    uint32_t sigma = runningStatSigma(stat);
+    uint32_t slack = expected * HOMING_TIMEOUT_SLACK_PCT / 100U;
+
+    if (sigma < HOMING_TIMEOUT_SIGMA_MIN)
+    {
+        sigma = HOMING_TIMEOUT_SIGMA_MIN;
+    }
+
+    if (slack < HOMING_TIMEOUT_SIGMA * sigma)
+    {
+        slack = HOMING_TIMEOUT_SIGMA * sigma;
+    }
+
+    // Debounce, settle and the slow touch off share the window with the stroke
+    expected += slack + homing->debounce_time_ms + homing->settle_time_ms + HOMING_TIMEOUT_MARGIN;
+
+    if (hasDutyControl(homing))
+    {
+        expected += 2U * homing->profile.backoff_ms + 2U * homing->profile.ramp_ms;
+    }
+
+    return (expected < homing->timeout_ms) ? expected : homing->timeout_ms;
+}
+
+/**
+ * \brief End of a settle at a limit. The full settle_time_ms is the upper
+ * bound; once the switch bounce is known the settle ends as soon as the switch
+ * has been closed for mean + HOMING_TIMEOUT_SIGMA * sigma of the bounce.
+ */
+static uint8_t settleDone(homing_t *homing, const debounce_t *db, uint32_t current_time)
+{
+    uint32_t end_time;
+
+    if (TON(&homing->ton_settle, 1, current_time, homing->settle_time_ms))
+    {
+        return 1;
+    }
+
+    return settleEarlyTime(homing, db, &end_time) && !TIME_BEFORE(current_time, end_time);
+}
+
+// Earliest end of the settle, 0 while the bounce statistics are not usable
+static uint8_t settleEarlyTime(const homing_t *homing, const debounce_t *db, uint32_t *end_time)
+{
+    if (runningStatCount(&homing->bounce_stat) < HOMING_STATS_MIN_SAMPLES || !db->state)
+    {
+        return 0;
+    }
+
+    uint32_t needed = runningStatMean(&homing->bounce_stat) +
+                      HOMING_TIMEOUT_SIGMA * runningStatSigma(&homing->bounce_stat);
+
+    if (needed < HOMING_SETTLE_MIN_TIME)
+    {
+        needed = HOMING_SETTLE_MIN_TIME;
+    }
+
+    // Stable since the raw edge behind the confirmed state
+    *end_time = debounceGetEdgeTime(db) + homing->debounce_time_ms + needed;
+
+    return 1;
+}
+
+static const debounce_t *settleSwitch(const homing_t *homing)
+{
+    switch (homing->state)
+    {
+        case HOMING_STATE_SETTLE_AT_RETRACT:
+        case HOMING_STATE_SETTLE_AT_RETRACT_2:
+            return &homing->db_retract_switch;
+
+        case HOMING_STATE_SETTLE_AT_EXTEND:
+            return &homing->db_extend_switch;
+
+        default:
+            return NULL;
+    }
+}
+
+static void considerDeadline(uint32_t candidate, uint32_t current_time, uint8_t *found, uint32_t *deadline)
+{
+    // Already due counts as now
+    if (!TIME_BEFORE(current_time, candidate))
+    {
+        candidate = current_time;
+    }
+
+    if (!*found || TIME_BEFORE(candidate, *deadline))
+    {
+        *deadline = candidate;
+        *found = 1;
+    }
+}
@@ -0,0 +1,212 @@
+#include "homing_group.h"
+#include "string.h"
+
+#define AXIS_BIT(idx) ((homing_axis_mask_t)(1U << (idx)))
+#define TIME_BEFORE(time,target) ((uint32_t)((target) - (time)) - 1U < 0x7FFFFFFFU)
+
+static uint8_t readSwitchLevels(const homing_funcs_t *funcs);
+
+
+void homingGroupInit(homing_group_t *group, uint32_t (*getSysTick)(void))
+{
+    memset(group, 0, sizeof(homing_group_t));
+
+    group->getSysTick = getSysTick;
+}
+
+
+/**
+ * \brief Bind a new axis to its own I/O callbacks.
+ * \return axis index, -1 if the group is full
+ */
+int8_t homingGroupAddAxis(homing_group_t *group, const homing_funcs_t *funcs)
+{
+    if (group->axis_count >= HOMING_GROUP_MAX_AXES)
+    {
+        return -1;
+    }
+
+    uint8_t idx = group->axis_count++;
+    homingInit(&group->axis[idx], funcs);
+    group->funcs[idx] = funcs;
+
+    return (int8_t)idx;
+}
+
+
+/**
+ * \brief Start homing on every axis in mask that is not already active.
+ * \return mask of the axes that were started
+ */
+homing_axis_mask_t homingGroupStart(homing_group_t *group, homing_axis_mask_t mask)
+{
+    homing_axis_mask_t started = 0;
+    homing_axis_mask_t pending = mask & (homing_axis_mask_t)(AXIS_BIT(group->axis_count) - 1U);
+
+    while (pending)
+    {
+        uint8_t idx = (uint8_t)__builtin_ctz(pending);
+        pending &= (homing_axis_mask_t)(pending - 1U);
+
+        if (homingStart(&group->axis[idx]))
+        {
+            started |= AXIS_BIT(idx);
+        }
+    }
+
+    group->active_mask |= started;
+    group->due_mask |= started;
+    group->homed_mask &= (homing_axis_mask_t)~started;
+    group->error_mask &= (homing_axis_mask_t)~started;
+
+    return started;
+}
+
+
+/**
+ * \brief One tick read for the whole pass. An active axis is only run when
+ * one of its switches changed or its homingNextDeadline() has come, so idle
+ * passes read the hot arrays and the switches but not the homing_t. Moving
+ * axes run every pass to keep their position current.
+ */
+void homingGroupProcess(homing_group_t *group)
+{
+    homing_axis_mask_t pending = group->active_mask | group->moving_mask;
+
+    if (!pending)
+    {
+        return;
+    }
+
+    uint32_t current_time = group->getSysTick();
+
+    while (pending)
+    {
+        uint8_t idx = (uint8_t)__builtin_ctz(pending);
+        homing_axis_mask_t bit = AXIS_BIT(idx);
+        pending &= (homing_axis_mask_t)(pending - 1U);
+
+        uint8_t levels = readSwitchLevels(group->funcs[idx]);
+
+        if (!((group->due_mask | group->moving_mask) & bit) && levels == group->switch_levels[idx] &&
+            (!(group->timed_mask & bit) || TIME_BEFORE(current_time, group->deadline[idx])))
+        {
+            continue;
+        }
+
+        group->switch_levels[idx] = levels;
+        group->due_mask &= (homing_axis_mask_t)~bit;
+
+        homing_t *axis = &group->axis[idx];
+
+        if (homingProcessEvent(axis, current_time, &group->deadline[idx]))
+        {
+            group->timed_mask |= bit;
+        }
+        else
+        {
+            group->timed_mask &= (homing_axis_mask_t)~bit;
+        }
+
+        if (!axis->position.is_moving)
+        {
+            group->moving_mask &= (homing_axis_mask_t)~bit;
+        }
+
+        if (!axis->is_homing_active && (group->active_mask & bit))
+        {
+            group->active_mask &= (homing_axis_mask_t)~bit;
+
+            if (axis->is_homed)
+            {
+                group->homed_mask |= bit;
+            }
+            else if (axis->error != HOMING_ERROR_NONE)
+            {
+                group->error_mask |= bit;
+            }
+        }
+    }
+}
+
+
+/**
+ * \brief Start a position move on every homed axis in mask.
+ * \return mask of the axes that accepted the move
+ */
+homing_axis_mask_t homingGroupMoveTo(homing_group_t *group, homing_axis_mask_t mask, uint8_t percent)
+{
+    homing_axis_mask_t started = 0;
+    homing_axis_mask_t pending = mask & group->homed_mask;
+
+    while (pending)
+    {
+        uint8_t idx = (uint8_t)__builtin_ctz(pending);
+        pending &= (homing_axis_mask_t)(pending - 1U);
+
+        if (homingMoveTo(&group->axis[idx], percent))
+        {
+            started |= AXIS_BIT(idx);
+
+            if (group->axis[idx].position.is_moving)
+            {
+                group->moving_mask |= AXIS_BIT(idx);
+            }
+        }
+    }
+
+    return started;
+}
+
+
+void homingGroupAbort(homing_group_t *group, homing_axis_mask_t mask)
+{
+    homing_axis_mask_t pending = mask & (homing_axis_mask_t)(AXIS_BIT(group->axis_count) - 1U);
+
+    while (pending)
+    {
+        uint8_t idx = (uint8_t)__builtin_ctz(pending);
+        pending &= (homing_axis_mask_t)(pending - 1U);
+
+        homingAbort(&group->axis[idx]);
+    }
+
+    group->active_mask &= (homing_axis_mask_t)~mask;
+    group->homed_mask &= (homing_axis_mask_t)~mask;
+    group->error_mask &= (homing_axis_mask_t)~mask;
+    group->moving_mask &= (homing_axis_mask_t)~mask;
+    group->timed_mask &= (homing_axis_mask_t)~mask;
+    group->due_mask &= (homing_axis_mask_t)~mask;
+}
+
+
+homing_t *homingGroupGetAxis(homing_group_t *group, uint8_t idx)
+{
+    return (idx < group->axis_count) ? &group->axis[idx] : NULL;
+}
+
+homing_axis_mask_t homingGroupGetActiveMask(const homing_group_t *group)
+{
+    return group->active_mask;
+}
+
+homing_axis_mask_t homingGroupGetHomedMask(const homing_group_t *group)
+{
+    return group->homed_mask;
+}
+
+homing_axis_mask_t homingGroupGetErrorMask(const homing_group_t *group)
+{
+    return group->error_mask;
+}
+
+homing_axis_mask_t homingGroupGetMovingMask(const homing_group_t *group)
+{
+    return group->moving_mask;
+}
+
+static uint8_t readSwitchLevels(const homing_funcs_t *funcs)
+{
+    return (uint8_t)((funcs->readRetractSwitch() ? 0x01U : 0U) |
+                     (funcs->readExtendSwitch() ? 0x02U : 0U));
+}
@@ -0,0 +1,87 @@
+#include "homing.h"
+#include "fmt.h"
+
+static uint32_t velocityUmPerSec(uint32_t travel_time_us);
+
+
+// Integer only, called once when homing completes
+void homingKinematicsUpdate(homing_t *homing)
+{
+    homing_kinematics_t *kin = &homing->kinematics;
+    uint32_t extend_us = homing->extend_travel_time_us;
+    uint32_t retract_us = homing->retract_travel_time_us;
+
+    kin->valid = 0;
+
+    if (!extend_us || !retract_us)
+    {
+        return;
+    }
+
+    kin->extend_velocity_um_s = velocityUmPerSec(extend_us);
+    kin->retract_velocity_um_s = velocityUmPerSec(retract_us);
+    kin->speed_ratio_q16 = (uint32_t)(((uint64_t)extend_us << 16) / retract_us);
+    kin->asymmetry_permille = (int32_t)(((int64_t)extend_us - retract_us) * 2000 /
+                                        ((int64_t)extend_us + retract_us));
+    kin->valid = 1;
+}
+
+const homing_kinematics_t *homingGetKinematics(const homing_t *homing)
+{
+    return homing->kinematics.valid ? &homing->kinematics : 0;
+}
+
+uint32_t homingGetExtendVelocity(const homing_t *homing)
+{
+    return homing->kinematics.extend_velocity_um_s;
+}
+
+uint32_t homingGetRetractVelocity(const homing_t *homing)
+{
+    return homing->kinematics.retract_velocity_um_s;
+}
+
+uint32_t homingGetSpeedRatioQ16(const homing_t *homing)
+{
+    return homing->kinematics.speed_ratio_q16;
+}
+
+int32_t homingGetAsymmetry(const homing_t *homing)
+{
+    return homing->kinematics.asymmetry_permille;
+}
+
+/**
+ * \brief Human readable kinematics, only on request, integer formatting only.
+ * \return length written, 0 if there is nothing valid yet
+ */
+uint16_t homingFormatKinematics(const homing_t *homing, char *buf, uint16_t size)
+{
+    const homing_kinematics_t *kin = &homing->kinematics;
+
+    if (!kin->valid || !size)
+    {
+        return 0;
+    }
+
+    uint32_t ratio_frac = ((kin->speed_ratio_q16 & 0xFFFFU) * 1000U) >> 16;
+    int32_t asym = kin->asymmetry_permille;
+
+    return fmtFormat(buf, size,
+                     "Extend %lu.%03lu mm/s, Retract %lu.%03lu mm/s, E/R %lu.%03lu, asym %c%ld.%01ld %%",
+                     (unsigned long)(kin->extend_velocity_um_s / 1000),
+                     (unsigned long)(kin->extend_velocity_um_s % 1000),
+                     (unsigned long)(kin->retract_velocity_um_s / 1000),
+                     (unsigned long)(kin->retract_velocity_um_s % 1000),
+                     (unsigned long)(kin->speed_ratio_q16 >> 16),
+                     (unsigned long)ratio_frac,
+                     (asym < 0) ? '-' : '+',
+                     (long)((asym < 0 ? -asym : asym) / 10),
+                     (long)((asym < 0 ? -asym : asym) % 10));
+}
+
+
+static uint32_t velocityUmPerSec(uint32_t travel_time_us)
+{
+    return (uint32_t)((uint64_t)ACTUATOR_STROKE_MM * 1000U * 1000000U / travel_time_us);
+}
@@ -0,0 +1,383 @@
+#include "homing.h"
+#include "string.h"
+
+#define LAST_KNOT (HOMING_MOTION_KNOTS - 1U)
+
+static void startPass(homing_t *homing, uint32_t current_time);
+static void enterPhase(homing_t *homing, homing_learn_state_t state, uint32_t current_time);
+static void learnDone(homing_t *homing);
+static void learnError(homing_t *homing, homing_error_t error);
+static uint8_t buildTable(homing_t *homing, uint8_t dir);
+static actuator_direction_t motionDirection(uint8_t dir);
+
+
+/**
+ * \brief Learn the motion table of both directions, axis must be homed.
+ * Pass k drives from rest at one switch for k * step ms, lets the actuator
+ * come to rest and times the remaining way to the far switch, then mirrors
+ * that towards the other switch. The long second leg runs at steady speed,
+ * so it tells how far the first, short one got including start latency and
+ * coast. Ends at the center, found with the new table.
+ * \return 0 if not homed or busy
+ */
+uint8_t homingStartLearn(homing_t *homing)
+{
+    if (!homing->is_homed || homing->is_homing_active || homing->position.is_moving)
+    {
+        return 0;
+    }
+
+    uint32_t now = homing->funcs->getSysTick();
+
+    memset(&homing->learn, 0, sizeof(homing_learn_t));
+
+    // Knots span half a stroke, the far half is steady speed
+    homing->motion.valid = 0;
+    homing->motion.step_ms[HOMING_MOTION_EXTEND] = homing->extend_travel_time_ms / (2U * LAST_KNOT);
+    homing->motion.step_ms[HOMING_MOTION_RETRACT] = homing->retract_travel_time_ms / (2U * LAST_KNOT);
+
+    if (!homing->motion.step_ms[HOMING_MOTION_EXTEND] || !homing->motion.step_ms[HOMING_MOTION_RETRACT])
+    {
+        return 0;
+    }
+
+    homing->state = HOMING_STATE_LEARN;
+    homing->error = HOMING_ERROR_NONE;
+    homing->is_homing_active = 1;
+    homing->is_homed = 0;
+    homing->progress_percent = 0;
+
+    homingPositionDrive(homing, ACTUATOR_DIR_RETRACT);
+    enterPhase(homing, HOMING_LEARN_TO_RETRACT, now);
+
+    return 1;
+}
+
+uint8_t homingLoadMotion(homing_t *homing, const homing_motion_t *motion)
+{
+    if (!motion->valid || !motion->step_ms[HOMING_MOTION_EXTEND] ||
+        !motion->step_ms[HOMING_MOTION_RETRACT] ||
+        !motion->slope_q16[HOMING_MOTION_EXTEND] || !motion->slope_q16[HOMING_MOTION_RETRACT])
+    {
+        return 0;
+    }
+
+    homing->motion = *motion;
+    return 1;
+}
+
+const homing_motion_t *homingGetMotion(const homing_t *homing)
+{
+    return homing->motion.valid ? &homing->motion : 0;
+}
+
+// One pass of HOMING_STATE_LEARN, switch inputs are already updated
+void homingLearnProcess(homing_t *homing, uint32_t current_time)
+{
+    homing_learn_t *learn = &homing->learn;
+    uint8_t extend = (learn->dir == HOMING_MOTION_EXTEND);
+    uint8_t start_raw = extend ? homing->retract_switch_raw : homing->extend_switch_raw;
+    uint8_t far_raw = extend ? homing->extend_switch_raw : homing->retract_switch_raw;
+    uint32_t elapsed = current_time - learn->phase_start;
+
+    if (TON(&homing->ton_timeout, 1, current_time, homing->timeout_ms))
+    {
+        learnError(homing, HOMING_ERROR_TIMEOUT);
+        return;
+    }
+
+    // Start latency, time from drive on until the switch we leave opens
+    if (learn->pass == 0 && !learn->released && !start_raw &&
+        learn->state == HOMING_LEARN_TO_SWITCH)
+    {
+        learn->released = 1;
+        learn->release_ms[learn->dir] = elapsed;
+    }
+
+    switch (learn->state)
+    {
+        case HOMING_LEARN_TO_RETRACT:
+        {
+            if (homing->retract_switch_raw)
+            {
+                homingPositionDrive(homing, ACTUATOR_DIR_STOP);
+                enterPhase(homing, HOMING_LEARN_SETTLE, current_time);
+            }
+            break;
+        }
+
+        case HOMING_LEARN_SEGMENT:
+        {
+            if (elapsed >= learn->on_time_ms)
+            {
+                homingPositionDrive(homing, ACTUATOR_DIR_STOP);
+                enterPhase(homing, HOMING_LEARN_COAST, current_time);
+            }
+            break;
+        }
+
+        case HOMING_LEARN_COAST:
+        {
+            if (elapsed >= homing->settle_time_ms)
+            {
+                homingPositionDrive(homing, motionDirection(learn->dir));
+                enterPhase(homing, HOMING_LEARN_TO_SWITCH, current_time);
+            }
+            break;
+        }
+
+        case HOMING_LEARN_TO_SWITCH:
+        {
+            if (far_raw)
+            {
+                homingPositionDrive(homing, ACTUATOR_DIR_STOP);
+                learn->to_switch_ms[learn->dir][learn->pass] = elapsed;
+                enterPhase(homing, HOMING_LEARN_SETTLE, current_time);
+            }
+            break;
+        }
+
+        case HOMING_LEARN_SETTLE:
+        {
+            if (elapsed < homing->settle_time_ms)
+            {
+                break;
+            }
+
+            // The contact that stopped us must still be there
+            uint8_t confirmed = (learn->started && extend) ? homing->extend_switch_debounced :
+                                                             homing->retract_switch_debounced;
+
+            if (!confirmed)
+            {
+                learnError(homing, HOMING_ERROR_NO_SWITCH_DETECTED);
+                break;
+            }
+
+            if (!learn->started)
+            {
+                // At rest on the retract switch, first pass from here
+                learn->started = 1;
+                startPass(homing, current_time);
+            }
+            else if (extend)
+            {
+                learn->dir = HOMING_MOTION_RETRACT;
+                startPass(homing, current_time);
+            }
+            else if (++learn->pass < HOMING_MOTION_KNOTS)
+            {
+                learn->dir = HOMING_MOTION_EXTEND;
+                homing->progress_percent = (uint8_t)((learn->pass * 100U) / HOMING_MOTION_KNOTS);
+                startPass(homing, current_time);
+            }
+            else if (buildTable(homing, HOMING_MOTION_EXTEND) && buildTable(homing, HOMING_MOTION_RETRACT))
+            {
+                homing->motion.valid = 1;
+                learn->dir = HOMING_MOTION_EXTEND;
+                learn->on_time_ms = homingMotionTime(homing, HOMING_MOTION_EXTEND, HOMING_POSITION_FULL / 2);
+                homingPositionDrive(homing, ACTUATOR_DIR_EXTEND);
+                enterPhase(homing, HOMING_LEARN_TO_CENTER, current_time);
+            }
+            else
+            {
+                learnError(homing, HOMING_ERROR_INVALID_TRAVEL);
+            }
+            break;
+        }
+
+        case HOMING_LEARN_TO_CENTER:
+        default:
+        {
+            if (elapsed >= learn->on_time_ms)
+            {
+                homingPositionDrive(homing, ACTUATOR_DIR_STOP);
+                learnDone(homing);
+            }
+            break;
+        }
+    }
+}
+
+// Next time a learning pass has to run, switch changes aside
+uint8_t homingLearnDeadline(const homing_t *homing, uint32_t *deadline)
+{
+    const homing_learn_t *learn = &homing->learn;
+    uint32_t phase_end;
+
+    switch (learn->state)
+    {
+        case HOMING_LEARN_SEGMENT:
+        case HOMING_LEARN_TO_CENTER:
+            phase_end = learn->phase_start + learn->on_time_ms;
+            break;
+
+        case HOMING_LEARN_COAST:
+        case HOMING_LEARN_SETTLE:
+            phase_end = learn->phase_start + homing->settle_time_ms;
+            break;
+
+        default:
+            if (!homing->ton_timeout.aux)
+            {
+                return 0;
+            }
+
+            *deadline = homing->ton_timeout.since;
+            return 1;
+    }
+
+    // The timeout of a timed phase is always later
+    *deadline = phase_end;
+    return 1;
+}
+
+/**
+ * \brief Distance covered from rest when driven for time_ms, O(1).
+ */
+uint32_t homingMotionDistance(const homing_t *homing, uint8_t dir, uint32_t time_ms)
+{
+    const homing_motion_t *motion = &homing->motion;
+    const uint32_t *distance = motion->distance_q16[dir];
+    uint32_t step = motion->step_ms[dir];
+    uint32_t last_time = step * LAST_KNOT;
+
+    if (time_ms >= last_time)
+    {
+        return distance[LAST_KNOT] +
+               (uint32_t)(((uint64_t)(time_ms - last_time) * motion->slope_q16[dir]) >> 16);
+    }
+
+    uint32_t k = time_ms / step;
+    uint32_t frac = time_ms - k * step;
+
+    return distance[k] + (uint32_t)((uint64_t)(distance[k + 1] - distance[k]) * frac / step);
+}
+
+/**
+ * \brief Drive time that covers distance_q16 from rest, the inverse of
+ * homingMotionDistance(). Rounded up.
+ */
+uint32_t homingMotionTime(const homing_t *homing, uint8_t dir, uint32_t distance_q16)
+{
+    const homing_motion_t *motion = &homing->motion;
+    const uint32_t *distance = motion->distance_q16[dir];
+    uint32_t step = motion->step_ms[dir];
+
+    if (distance_q16 >= distance[LAST_KNOT])
+    {
+        uint64_t rest = (uint64_t)(distance_q16 - distance[LAST_KNOT]) << 16;
+
+        return step * LAST_KNOT + (uint32_t)((rest + motion->slope_q16[dir] - 1) / motion->slope_q16[dir]);
+    }
+
+    for (uint32_t k = 0; k < LAST_KNOT; ++k)
+    {
+        if (distance_q16 <= distance[k + 1])
+        {
+            uint32_t span = distance[k + 1] - distance[k];
+
+            if (!span)
+            {
+                return k * step;
+            }
+
+            return k * step + (uint32_t)(((uint64_t)(distance_q16 - distance[k]) * step + span - 1) / span);
+        }
+    }
+
+    return step * LAST_KNOT;
+}
+
+
+static void startPass(homing_t *homing, uint32_t current_time)
+{
+    homing_learn_t *learn = &homing->learn;
+
+    learn->on_time_ms = learn->pass * homing->motion.step_ms[learn->dir];
+    learn->released = 0;
+
+    homingPositionDrive(homing, motionDirection(learn->dir));
+
+    // Pass 0 is the full stroke from rest
+    enterPhase(homing, learn->on_time_ms ? HOMING_LEARN_SEGMENT : HOMING_LEARN_TO_SWITCH, current_time);
+}
+
+static void enterPhase(homing_t *homing, homing_learn_state_t state, uint32_t current_time)
+{
+    homing->learn.state = state;
+    homing->learn.phase_start = current_time;
+    homing->ton_timeout.aux = 0;
+    TON(&homing->ton_timeout, 1, current_time, homing->timeout_ms);
+}
+
+static void learnDone(homing_t *homing)
+{
+    homing->state = HOMING_STATE_COMPLETE;
+    homing->is_homed = 1;
+    homing->progress_percent = 100;
+    homingPositionCalibrate(homing);
+}
+
+static void learnError(homing_t *homing, homing_error_t error)
+{
+    homingPositionDrive(homing, ACTUATOR_DIR_STOP);
+    homing->motion.valid = 0;
+    homing->error = error;
+    homing->state = HOMING_STATE_ERROR;
+
+    HOMING_TRACE_EVENT(homing, TRACE_HOMING_ERROR, error, 0);
+}
+
+/**
+ * \brief Knot k from pass k. The second leg from rest to the far switch took
+ * to_switch_ms, at steady speed that is full - distance(k * step). Steady
+ * speed is one stroke per full pass time less the start latency.
+ */
+static uint8_t buildTable(homing_t *homing, uint8_t dir)
+{
+    const homing_learn_t *learn = &homing->learn;
+    homing_motion_t *motion = &homing->motion;
+    uint32_t full_ms = learn->to_switch_ms[dir][0];
+    uint32_t latency_ms = learn->release_ms[dir];
+    uint32_t prev = 0;
+
+    if (full_ms <= latency_ms + homing->min_travel_time_ms)
+    {
+        return 0;
+    }
+
+    uint32_t steady_ms = full_ms - latency_ms;
+
+    for (uint32_t k = 0; k < HOMING_MOTION_KNOTS; ++k)
+    {
+        uint32_t to_switch_ms = learn->to_switch_ms[dir][k];
+        uint32_t distance = 0;
+
+        if (to_switch_ms < full_ms)
+        {
+            distance = (uint32_t)(((uint64_t)HOMING_POSITION_FULL * (full_ms - to_switch_ms)) / steady_ms);
+        }
+
+        // Timing jitter must not make the table run backwards
+        prev = (distance > prev) ? distance : prev;
+        motion->distance_q16[dir][k] = prev;
+    }
+
+    motion->slope_q16[dir] = (uint32_t)(((uint64_t)HOMING_POSITION_FULL << 16) / steady_ms);
+    motion->latency_ms[dir] = latency_ms;
+
+    // What the last knot got beyond steady driving from the latency on
+    uint32_t last_ms = motion->step_ms[dir] * LAST_KNOT;
+    uint32_t steady_q16 = (last_ms > latency_ms) ?
+                          (uint32_t)(((uint64_t)(last_ms - latency_ms) * motion->slope_q16[dir]) >> 16) : 0;
+
+    motion->coast_q16[dir] = (prev > steady_q16) ? prev - steady_q16 : 0;
+
+    return 1;
+}
+
+static actuator_direction_t motionDirection(uint8_t dir)
+{
+    return (dir == HOMING_MOTION_EXTEND) ? ACTUATOR_DIR_EXTEND : ACTUATOR_DIR_RETRACT;
+}
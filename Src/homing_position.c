@@ -0,0 +1,274 @@
+#include "homing.h"
+
+#define PERCENT_TO_Q16(p) ((uint32_t)(((uint64_t)(p) * HOMING_POSITION_FULL) / 100U))
+
+static uint32_t travelRateQ16(uint32_t travel_time_us);
+static uint8_t motionIndex(actuator_direction_t dir);
+
+
+void homingPositionInit(homing_t *homing)
+{
+    homing->position.min_q16 = 0;
+    homing->position.max_q16 = HOMING_POSITION_FULL;
+    homing->position.is_moving = 0;
+    homing->position.start_pending = 0;
+}
+
+// Homing ends at the center, derive both rates from the measured travel times
+void homingPositionCalibrate(homing_t *homing)
+{
+    homing_position_t *pos = &homing->position;
+
+    // The measured strokes started with a ramp, worth half a ramp at cruise speed
+    uint32_t loss_us = homingRampTime(homing) * 1000U / 2U;
+
+    pos->extend_rate_q16 = travelRateQ16(homing->extend_travel_time_us - loss_us);
+    pos->retract_rate_q16 = travelRateQ16(homing->retract_travel_time_us - loss_us);
+    pos->current_q16 = HOMING_POSITION_FULL / 2;
+    pos->target_q16 = pos->current_q16;
+    pos->is_moving = 0;
+    pos->start_pending = 0;
+}
+
+/**
+ * \brief Start a dead reckoning move, clamped to the soft limits.
+ * \param percent - 0 retract limit, 100 extend limit
+ * \return 0 if the axis is not homed or homing is running
+ */
+uint8_t homingMoveTo(homing_t *homing, uint8_t percent)
+{
+    homing_position_t *pos = &homing->position;
+
+    if (!homing->is_homed || homing->is_homing_active)
+    {
+        return 0;
+    }
+
+    uint32_t now = homing->funcs->getSysTick();
+
+    if (pos->is_moving)
+    {
+        // Re-plan from where the running move has got to
+        homingPositionProcess(homing, now);
+    }
+
+    uint32_t target = PERCENT_TO_Q16(percent > 100 ? 100 : percent);
+
+    if (target < pos->min_q16)
+    {
+        target = pos->min_q16;
+    }
+    else if (target > pos->max_q16)
+    {
+        target = pos->max_q16;
+    }
+
+    if (target == pos->current_q16)
+    {
+        homingStopMove(homing);
+        pos->target_q16 = target;
+        return 1;
+    }
+
+    uint32_t distance;
+    uint32_t rate;
+    actuator_direction_t dir;
+
+    if (target > pos->current_q16)
+    {
+        distance = target - pos->current_q16;
+        rate = pos->extend_rate_q16;
+        dir = ACTUATOR_DIR_EXTEND;
+    }
+    else
+    {
+        distance = pos->current_q16 - target;
+        rate = pos->retract_rate_q16;
+        dir = ACTUATOR_DIR_RETRACT;
+    }
+
+    if (!rate)
+    {
+        return 0;
+    }
+
+    pos->target_q16 = target;
+    pos->start_q16 = pos->current_q16;
+
+    if (pos->is_moving && pos->start_pending)
+    {
+        // Still settling from a reversal, keep the planned start
+    }
+    else if (homing->actuator_dir != ACTUATOR_DIR_STOP && homing->actuator_dir != dir)
+    {
+        // Never reverse a running motor, stop and let it settle first
+        homingPositionDrive(homing, ACTUATOR_DIR_STOP);
+        pos->move_start_time = now + homing->settle_time_ms;
+        pos->start_pending = 1;
+    }
+    else
+    {
+        pos->move_start_time = now;
+        pos->start_pending = 0;
+    }
+
+    pos->move_dir = dir;
+
+    if (homing->motion.valid)
+    {
+        pos->move_duration_ms = homingMotionTime(homing, motionIndex(dir), distance);
+    }
+    else
+    {
+        pos->move_duration_ms = (uint32_t)((((uint64_t)distance << 16) + rate - 1) / rate);
+    }
+    pos->is_moving = 1;
+
+    if (!pos->start_pending)
+    {
+        homingPositionDrive(homing, dir);
+    }
+
+    return 1;
+}
+
+void homingStopMove(homing_t *homing)
+{
+    if (homing->position.is_moving)
+    {
+        homingPositionProcess(homing, homing->funcs->getSysTick());
+    }
+
+    homing->position.is_moving = 0;
+    homing->position.start_pending = 0;
+    homingPositionDrive(homing, ACTUATOR_DIR_STOP);
+}
+
+uint8_t homingIsMoving(const homing_t *homing)
+{
+    return homing->position.is_moving;
+}
+
+// Estimated position in percent of the stroke
+uint8_t homingGetPosition(const homing_t *homing)
+{
+    return (uint8_t)(((uint64_t)homing->position.current_q16 * 100U + HOMING_POSITION_FULL / 2) /
+                     HOMING_POSITION_FULL);
+}
+
+uint32_t homingGetPositionQ16(const homing_t *homing)
+{
+    return homing->position.current_q16;
+}
+
+void homingSetSoftLimits(homing_t *homing, uint8_t min_percent, uint8_t max_percent)
+{
+    if (max_percent > 100)
+    {
+        max_percent = 100;
+    }
+
+    if (min_percent > max_percent)
+    {
+        min_percent = max_percent;
+    }
+
+    homing->position.min_q16 = PERCENT_TO_Q16(min_percent);
+    homing->position.max_q16 = PERCENT_TO_Q16(max_percent);
+}
+
+// Integrate the running move, stop once the planned duration has elapsed
+void homingPositionProcess(homing_t *homing, uint32_t current_time)
+{
+    homing_position_t *pos = &homing->position;
+
+    if (!pos->is_moving)
+    {
+        return;
+    }
+
+    if (pos->start_pending)
+    {
+        if ((int32_t)(current_time - pos->move_start_time) < 0)
+        {
+            return;
+        }
+
+        pos->start_pending = 0;
+        homingPositionDrive(homing, pos->move_dir);
+    }
+
+    uint32_t elapsed = current_time - pos->move_start_time;
+
+    if (elapsed >= pos->move_duration_ms)
+    {
+        homingPositionDrive(homing, ACTUATOR_DIR_STOP);
+        pos->current_q16 = pos->target_q16;
+        pos->is_moving = 0;
+        return;
+    }
+
+    uint32_t moved;
+
+    if (homing->motion.valid)
+    {
+        // The table distance includes the coast still to come
+        uint8_t dir = motionIndex(pos->move_dir);
+        uint32_t reach = homingMotionDistance(homing, dir, elapsed);
+        uint32_t coast = homing->motion.coast_q16[dir];
+
+        moved = (reach > coast) ? reach - coast : 0;
+    }
+    else
+    {
+        uint32_t rate = (pos->move_dir == ACTUATOR_DIR_EXTEND) ? pos->extend_rate_q16 : pos->retract_rate_q16;
+
+        moved = (uint32_t)(((uint64_t)elapsed * rate) >> 16);
+    }
+
+    if (pos->move_dir == ACTUATOR_DIR_EXTEND)
+    {
+        pos->current_q16 = pos->start_q16 + moved;
+    }
+    else
+    {
+        pos->current_q16 = (moved < pos->start_q16) ? pos->start_q16 - moved : 0;
+    }
+}
+
+// Also used by the learning passes, which must run like the positioning moves
+void homingPositionDrive(homing_t *homing, actuator_direction_t dir)
+{
+    homing->actuator_dir = dir;
+
+    HOMING_TRACE_EVENT(homing, TRACE_HOMING_ACTUATOR, dir, (dir == ACTUATOR_DIR_STOP) ? 0 : homing->profile.fast_duty);
+
+    if (homing->funcs && homing->funcs->setActuatorDirection)
+    {
+        homing->funcs->setActuatorDirection(dir);
+    }
+
+    // Positioning moves run at the fast duty without ramps
+    if (homing->funcs && homing->funcs->setActuatorDuty)
+    {
+        homing->drive_duty = (dir == ACTUATOR_DIR_STOP) ? 0 : homing->profile.fast_duty;
+        homing->funcs->setActuatorDuty(homing->drive_duty);
+    }
+}
+
+
+// Full stroke per travel time, as position units per ms in Q16.16
+static uint32_t travelRateQ16(uint32_t travel_time_us)
+{
+    if (!travel_time_us)
+    {
+        return 0;
+    }
+
+    return (uint32_t)((((uint64_t)HOMING_POSITION_FULL << 16) * 1000U) / travel_time_us);
+}
+
+static uint8_t motionIndex(actuator_direction_t dir)
+{
+    return (dir == ACTUATOR_DIR_EXTEND) ? HOMING_MOTION_EXTEND : HOMING_MOTION_RETRACT;
+}
@@ -0,0 +1,89 @@
+#include "limit_capture.h"
+#include "string.h"
+
+#define QUEUE_MASK (LIMIT_CAPTURE_QUEUE_SIZE - 1)
+
+#if (LIMIT_CAPTURE_QUEUE_SIZE & QUEUE_MASK) != 0
+#error "LIMIT_CAPTURE_QUEUE_SIZE must be a power of two"
+#endif
+
+// Keeps the compiler from moving the slot write past the index publish
+#define COMPILER_BARRIER() __asm volatile ("" ::: "memory")
+
+
+void limitCaptureInit(limit_capture_t *cap)
+{
+    memset((void *)cap, 0, sizeof(limit_capture_t));
+}
+
+// Accept the next active edge on channel, older ones are dropped
+void limitCaptureArm(limit_capture_t *cap, uint8_t channel)
+{
+    if (channel < LIMIT_CAPTURE_CHANNELS)
+    {
+        cap->armed[channel] = 1;
+    }
+}
+
+void limitCaptureDisarm(limit_capture_t *cap, uint8_t channel)
+{
+    if (channel < LIMIT_CAPTURE_CHANNELS)
+    {
+        cap->armed[channel] = 0;
+    }
+}
+
+/**
+ * \brief Record an edge from the EXTI handler.
+ * \param level - raw switch level after the edge, only active (1) edges are kept
+ * \param cycles - CYCCNT read as early as possible in the handler
+ */
+void limitCaptureFromISR(limit_capture_t *cap, uint8_t channel, uint8_t level, uint32_t cycles)
+{
+    if (channel >= LIMIT_CAPTURE_CHANNELS || !level || !cap->armed[channel])
+    {
+        return;
+    }
+
+    uint8_t head = cap->head;
+    uint8_t next = (uint8_t)((head + 1) & QUEUE_MASK);
+
+    if (next == cap->tail)
+    {
+        cap->overflow_count++;
+        return;
+    }
+
+    // First edge only, the bounces that follow must not overwrite it
+    cap->armed[channel] = 0;
+
+    cap->queue[head].cycles = cycles;
+    cap->queue[head].channel = channel;
+    cap->queue[head].level = level;
+
+    COMPILER_BARRIER();
+    cap->head = next;
+}
+
+uint8_t limitCapturePop(limit_capture_t *cap, limit_capture_event_t *event)
+{
+    uint8_t tail = cap->tail;
+
+    if (tail == cap->head)
+    {
+        return 0;
+    }
+
+    COMPILER_BARRIER();
+    *event = cap->queue[tail];
+
+    COMPILER_BARRIER();
+    cap->tail = (uint8_t)((tail + 1) & QUEUE_MASK);
+
+    return 1;
+}
+
+uint32_t limitCaptureGetOverflowCount(const limit_capture_t *cap)
+{
+    return cap->overflow_count;
+}
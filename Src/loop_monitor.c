@@ -0,0 +1,157 @@
+#include "loop_monitor.h"
+#include "string.h"
+
+#ifdef LOOP_MONITOR_HOST
+#include <stdio.h>
+#define LOOP_MONITOR_PRINT printf
+#else
+#include "retarget.h"
+#define LOOP_MONITOR_PRINT print
+#endif
+
+static void histAdd(uint32_t *hist, uint32_t us);
+static void worstAdd(loop_monitor_t *lm, const loop_sample_t *sample);
+static void dumpHist(const char *name, const uint32_t *hist);
+
+
+/**
+ * \param budget_us - iterations running longer raise an overrun, 0 for
+ * LOOP_MONITOR_BUDGET_US
+ */
+void loopMonitorInit(loop_monitor_t *lm, uint32_t budget_us)
+{
+  memset(lm, 0, sizeof(loop_monitor_t));
+  lm->budget_us = budget_us ? budget_us : LOOP_MONITOR_BUDGET_US;
+}
+
+// First thing in run(), tag is e.g. the active state_t
+void loopMonitorBegin(loop_monitor_t *lm, uint32_t now_us, uint8_t tag)
+{
+  if (lm->started)
+  {
+    uint32_t period = now_us - lm->current.start_us;
+
+    histAdd(lm->period_hist, period);
+
+    if (period > lm->max_period_us)
+    {
+      lm->max_period_us = period;
+    }
+
+    lm->current.period_us = period;
+  }
+
+  lm->current.start_us = now_us;
+  lm->current.tag = tag;
+  lm->started = 1;
+}
+
+// Last thing in run()
+void loopMonitorEnd(loop_monitor_t *lm, uint32_t now_us)
+{
+  if (!lm->started)
+  {
+    return;
+  }
+
+  lm->current.exec_us = now_us - lm->current.start_us;
+  lm->iterations++;
+  histAdd(lm->exec_hist, lm->current.exec_us);
+  worstAdd(lm, &lm->current);
+
+  if (lm->current.exec_us > lm->budget_us)
+  {
+    lm->overrun_count++;
+    lm->overrun = lm->current;
+    lm->overrun_pending = 1;
+  }
+}
+
+/**
+ * \brief Overrun event: the latest iteration over budget since the last call.
+ * \return 0 if there was none
+ */
+uint8_t loopMonitorTakeOverrun(loop_monitor_t *lm, loop_sample_t *overrun)
+{
+  if (!lm->overrun_pending)
+  {
+    return 0;
+  }
+
+  *overrun = lm->overrun;
+  lm->overrun_pending = 0;
+  return 1;
+}
+
+/**
+ * \brief Print the monitor as CSV lines:
+ * LOOP,summary,iterations,overruns,budget_us,max_period_us
+ * LOOP,period|exec,bucket:count,...
+ * LOOP,worst,exec_us,period_us,start_us,tag
+ */
+void loopMonitorDump(const loop_monitor_t *lm)
+{
+  LOOP_MONITOR_PRINT("LOOP,summary,%lu,%lu,%lu,%lu\r\n", (unsigned long)lm->iterations,
+      (unsigned long)lm->overrun_count, (unsigned long)lm->budget_us,
+      (unsigned long)lm->max_period_us);
+
+  dumpHist("period", lm->period_hist);
+  dumpHist("exec", lm->exec_hist);
+
+  for (uint8_t i = 0; i < LOOP_MONITOR_WORST; ++i)
+  {
+    const loop_sample_t *w = &lm->worst[i];
+
+    if (w->exec_us)
+    {
+      LOOP_MONITOR_PRINT("LOOP,worst,%lu,%lu,%lu,%u\r\n", (unsigned long)w->exec_us,
+          (unsigned long)w->period_us, (unsigned long)w->start_us, w->tag);
+    }
+  }
+}
+
+
+static void histAdd(uint32_t *hist, uint32_t us)
+{
+  uint8_t bucket = (uint8_t)(31 - __builtin_clz(us | 1U));
+
+  if (bucket >= LOOP_MONITOR_HIST_BUCKETS)
+  {
+    bucket = LOOP_MONITOR_HIST_BUCKETS - 1;
+  }
+
+  hist[bucket]++;
+}
+
+// Keep the LOOP_MONITOR_WORST longest iterations, most iterations return at once
+static void worstAdd(loop_monitor_t *lm, const loop_sample_t *sample)
+{
+  int8_t i = LOOP_MONITOR_WORST - 1;
+
+  if (sample->exec_us <= lm->worst[i].exec_us)
+  {
+    return;
+  }
+
+  for (; i > 0 && lm->worst[i - 1].exec_us < sample->exec_us; --i)
+  {
+    lm->worst[i] = lm->worst[i - 1];
+  }
+
+  lm->worst[i] = *sample;
+}
+
+static void dumpHist(const char *name, const uint32_t *hist)
+{
+  LOOP_MONITOR_PRINT("LOOP,%s", name);
+
+  for (uint8_t b = 0; b < LOOP_MONITOR_HIST_BUCKETS; ++b)
+  {
+    if (hist[b])
+    {
+      LOOP_MONITOR_PRINT(",%u:%lu", b, (unsigned long)hist[b]);
+    }
+  }
+
+  LOOP_MONITOR_PRINT("\r\n");
+}
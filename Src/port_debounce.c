@@ -0,0 +1,81 @@
+#include "port_debounce.h"
+#include "string.h"
+
+// The port has to be complete before the sampling interrupt can see it
+#define COMPILER_BARRIER() __asm volatile ("" ::: "memory")
+
+
+void portDebounceInit(port_debounce_t *pd)
+{
+  memset((void *)pd, 0, sizeof(port_debounce_t));
+}
+
+/**
+ * \brief Register a port, safe while the sampling interrupt is running.
+ * \param idr - e.g. &GPIOA->IDR
+ * \param mask - pins to debounce, the others always read inactive
+ * \return port index for the readers, -1 if all ports are taken
+ */
+int8_t portDebounceAddPort(port_debounce_t *pd, volatile const uint32_t *idr, uint16_t mask, uint16_t active_low)
+{
+  if (pd->count >= PORT_DEBOUNCE_PORTS)
+  {
+    return -1;
+  }
+
+  port_debounce_port_t *port = &pd->port[pd->count];
+
+  port->idr = idr;
+  port->mask = mask;
+  port->active_low = active_low;
+  port->ct0 = 0xFFFFU;
+  port->ct1 = 0xFFFFU;
+  // Start from the current levels instead of reporting them as edges
+  port->stable = (uint16_t)((*idr ^ active_low) & mask);
+
+  COMPILER_BARRIER();
+  return (int8_t)pd->count++;
+}
+
+// Call at a fixed rate, e.g. from SysTick_Handler
+void portDebounceTick(port_debounce_t *pd)
+{
+  for (uint8_t i = 0; i < pd->count; ++i)
+  {
+    port_debounce_port_t *port = &pd->port[i];
+    uint16_t sample = (uint16_t)((*port->idr ^ port->active_low) & port->mask);
+    uint16_t stable = port->stable;
+    uint16_t delta = sample ^ stable;
+
+    // 2 bit counter per pin: reset while the pin agrees with its state,
+    // counts down while it differs and toggles the state on the 4th sample
+    port->ct0 = (uint16_t)~(port->ct0 & delta);
+    port->ct1 = (uint16_t)(port->ct0 ^ (port->ct1 & delta));
+
+    uint16_t toggle = delta & port->ct0 & port->ct1;
+
+    if (toggle)
+    {
+      stable ^= toggle;
+      port->stable = stable;
+      __atomic_fetch_or(&port->rising, (uint16_t)(toggle & stable), __ATOMIC_RELAXED);
+      __atomic_fetch_or(&port->falling, (uint16_t)(toggle & ~stable), __ATOMIC_RELAXED);
+    }
+  }
+}
+
+uint16_t portDebounceStable(const port_debounce_t *pd, uint8_t port)
+{
+  return port < pd->count ? pd->port[port].stable : 0;
+}
+
+// Pins that became active since the last call
+uint16_t portDebounceTakeRising(port_debounce_t *pd, uint8_t port)
+{
+  return port < pd->count ? __atomic_exchange_n(&pd->port[port].rising, 0, __ATOMIC_RELAXED) : 0;
+}
+
+uint16_t portDebounceTakeFalling(port_debounce_t *pd, uint8_t port)
+{
+  return port < pd->count ? __atomic_exchange_n(&pd->port[port].falling, 0, __ATOMIC_RELAXED) : 0;
+}
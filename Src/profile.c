@@ -0,0 +1,107 @@
+#include "profile.h"
+
+#ifdef PROFILE_HOST
+#include <stdio.h>
+#define PROFILE_PRINT printf
+#else
+#include "retarget.h"
+#define PROFILE_PRINT print
+#endif
+
+static profile_probe_t *probe_table[PROFILE_MAX_PROBES];
+static uint8_t probe_count;
+static uint32_t dropped_probes;
+
+
+/**
+ * \brief Add one measurement, the probe joins the table on its first one.
+ * \param cycles - elapsed PROFILE_NOW() ticks
+ */
+void profileRecord(profile_probe_t *probe, uint32_t cycles)
+{
+  if (!probe->registered)
+  {
+    if (probe_count >= PROFILE_MAX_PROBES)
+    {
+      dropped_probes++;
+      return;
+    }
+
+    probe_table[probe_count++] = probe;
+    probe->registered = 1;
+    probe->min = UINT32_MAX;
+  }
+
+  uint8_t bucket = (uint8_t)(31 - __builtin_clz(cycles | 1U));
+
+  if (bucket >= PROFILE_HIST_BUCKETS)
+  {
+    bucket = PROFILE_HIST_BUCKETS - 1;
+  }
+
+  probe->count++;
+  probe->sum += cycles;
+  probe->hist[bucket]++;
+
+  if (cycles < probe->min)
+  {
+    probe->min = cycles;
+  }
+
+  if (cycles > probe->max)
+  {
+    probe->max = cycles;
+  }
+}
+
+// Clear the statistics, the probes stay in the table
+void profileReset(void)
+{
+  for (uint8_t i = 0; i < probe_count; ++i)
+  {
+    profile_probe_t *probe = probe_table[i];
+
+    probe->count = 0;
+    probe->sum = 0;
+    probe->min = UINT32_MAX;
+    probe->max = 0;
+
+    for (uint8_t b = 0; b < PROFILE_HIST_BUCKETS; ++b)
+    {
+      probe->hist[b] = 0;
+    }
+  }
+}
+
+/**
+ * \brief Print the table, one CSV line per probe:
+ * PROFILE,name,unit,count,min,mean,max,bucket:count,...
+ * with only the non-empty log2 buckets listed.
+ */
+void profileDump(void)
+{
+  for (uint8_t i = 0; i < probe_count; ++i)
+  {
+    const profile_probe_t *probe = probe_table[i];
+    uint32_t mean = probe->count ? (uint32_t)(probe->sum / probe->count) : 0;
+
+    PROFILE_PRINT("PROFILE,%s,%s,%lu,%lu,%lu,%lu", probe->name, PROFILE_UNIT,
+        (unsigned long)probe->count, (unsigned long)(probe->count ? probe->min : 0),
+        (unsigned long)mean, (unsigned long)probe->max);
+
+    for (uint8_t b = 0; b < PROFILE_HIST_BUCKETS; ++b)
+    {
+      if (probe->hist[b])
+      {
+        PROFILE_PRINT(",%u:%lu", b, (unsigned long)probe->hist[b]);
+      }
+    }
+
+    PROFILE_PRINT("\r\n");
+  }
+
+  if (dropped_probes)
+  {
+    PROFILE_PRINT("PROFILE,dropped,%lu\r\n", (unsigned long)dropped_probes);
+  }
+}
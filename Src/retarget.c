@@ -8,36 +8,36 @@
 #include "retarget.h"
 #include "stdarg.h"
 #include "usbd_cdc_if.h"
+#include "cdc_tx.h"
+#include "cdc_rx.h"
+#include "fmt.h"
 
+// Longer lines are cut
+#define PRINT_LINE_MAX 128
+
+/**
+ * \brief Format into a local buffer and queue it for USB, never waits. The
+ * line goes out from the transmit complete callback or cdcTxPoll().
+ */
 void print(const char *format, ...)
 {
+   char line[PRINT_LINE_MAX];
    va_list va;
 
    va_start(va, format);
-
-   vsprintf((char*)UserTxBufferFS, format, va);
-   uint16_t len = strlen((const char*)UserTxBufferFS);
-   CDC_Transmit_FS(UserTxBufferFS, len);
-   while (!usb_tx_len);
-   usb_tx_len = 0;
-
+   uint16_t len = fmtFormatV(line, sizeof(line), format, va);
    va_end(va);
+
+   cdcTxWrite(line, len);
 }
 
-int scan(const char *format, ... )
+/**
+ * \brief Next line received over USB, without its terminator. Points into
+ * the receive ring and stays valid until the next call, split it with
+ * sliceNextToken().
+ * \return 0 if no complete line has arrived yet
+ */
+uint8_t scanLine(slice_t *line)
 {
-   va_list va;
-
-   if (!usb_rx_len)
-      return 0;
-
-   va_start(va, format);
-   int len = vsscanf((const char*)UserRxBufferFS, format, va);
-
-   va_end(va);
-   usb_rx_len = 0;
-
-   return len;
+   return cdcRxGetLine(line);
 }
-
-
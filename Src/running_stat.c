@@ -0,0 +1,84 @@
+#include "running_stat.h"
+
+static uint32_t isqrt64(uint64_t val);
+
+void runningStatReset(running_stat_t *obj)
+{
+	obj->count = 0;
+	obj->sum = 0;
+	obj->sum_sq = 0;
+}
+
+/**
+ * \fn void runningStatAdd(running_stat_t *obj, uint32_t sample)
+ * \brief Add a sample (e.g. ms). Once the window is full all sums are halved,
+ * so the statistics follow slow drift such as wear or temperature.
+ */
+void runningStatAdd(running_stat_t *obj, uint32_t sample)
+{
+	if (obj->count >= RUNNING_STAT_WINDOW)
+	{
+		obj->count >>= 1;
+		obj->sum >>= 1;
+		obj->sum_sq >>= 1;
+	}
+
+	obj->count++;
+	obj->sum += sample;
+	obj->sum_sq += (uint64_t)sample * sample;
+}
+
+uint32_t runningStatCount(const running_stat_t *obj)
+{
+	return obj->count;
+}
+
+uint32_t runningStatMean(const running_stat_t *obj)
+{
+	return obj->count ? obj->sum / obj->count : 0;
+}
+
+// Sample standard deviation, 0 below two samples
+uint32_t runningStatSigma(const running_stat_t *obj)
+{
+	if (obj->count < 2)
+	{
+		return 0;
+	}
+
+	uint64_t sq_of_sum = ((uint64_t)obj->sum * obj->sum) / obj->count;
+
+	if (obj->sum_sq <= sq_of_sum)
+	{
+		return 0;
+	}
+
+	return isqrt64((obj->sum_sq - sq_of_sum) / (obj->count - 1));
+}
+
+static uint32_t isqrt64(uint64_t val)
+{
+	uint64_t res = 0;
+	uint64_t bit = (uint64_t)1 << 62;
+
+	while (bit > val)
+	{
+		bit >>= 2;
+	}
+
+	while (bit)
+	{
+		if (val >= res + bit)
+		{
+			val -= res + bit;
+			res = (res >> 1) + bit;
+		}
+		else
+		{
+			res >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return (uint32_t)res;
+}
@@ -0,0 +1,218 @@
+#include "rx_ring.h"
+#include "string.h"
+
+#if RX_RING_SIZE > 0xFFFF || RX_RING_SIZE < 4 * RX_RING_PACKET
+#error "RX_RING_SIZE out of range"
+#endif
+
+#define COMPILER_BARRIER() __asm volatile ("" ::: "memory")
+
+// Unread data as seen by the consumer: seg1 bytes at read, then wrapped
+// bytes at the start of the buffer
+typedef struct
+{
+    uint16_t read;
+    uint16_t seg1;
+    uint16_t total;
+} rx_view_t;
+
+
+static void takeView(rx_ring_t *ring, rx_view_t *view)
+{
+    uint16_t w = __atomic_load_n(&ring->write, __ATOMIC_ACQUIRE);
+    uint16_t r = ring->read;
+
+    if (w < r)
+    {
+        // wrap is stored before write goes back to the start
+        uint16_t wrap = ring->wrap;
+
+        if (r == wrap)
+        {
+            r = 0;
+            __atomic_store_n(&ring->read, r, __ATOMIC_RELEASE);
+            view->seg1 = w;
+            view->total = w;
+        }
+        else
+        {
+            view->seg1 = (uint16_t)(wrap - r);
+            view->total = (uint16_t)(view->seg1 + w);
+        }
+    }
+    else
+    {
+        view->seg1 = (uint16_t)(w - r);
+        view->total = view->seg1;
+    }
+
+    view->read = r;
+}
+
+static uint8_t viewByte(const rx_ring_t *ring, const rx_view_t *view, uint16_t i)
+{
+    return i < view->seg1 ? ring->buf[view->read + i] : ring->buf[i - view->seg1];
+}
+
+static void release(rx_ring_t *ring, const rx_view_t *view, uint16_t count)
+{
+    uint16_t r;
+
+    if (count >= view->seg1 && view->total > view->seg1)
+    {
+        r = (uint16_t)(count - view->seg1);
+    }
+    else
+    {
+        r = (uint16_t)(view->read + count);
+    }
+
+    COMPILER_BARRIER();
+    __atomic_store_n(&ring->read, r, __ATOMIC_RELEASE);
+}
+
+void rxRingInit(rx_ring_t *ring)
+{
+    memset(ring, 0, sizeof(rx_ring_t));
+}
+
+/**
+ * \brief Producer: room for the next RX_RING_PACKET bytes, received into in
+ * place and then passed to rxRingCommit().
+ * \return NULL while the ring is too full, try again after the consumer ran
+ */
+uint8_t *rxRingReserve(rx_ring_t *ring)
+{
+    uint16_t w = ring->write;
+    uint16_t r = __atomic_load_n(&ring->read, __ATOMIC_ACQUIRE);
+
+    if (w >= r)
+    {
+        if (RX_RING_SIZE - w >= RX_RING_PACKET)
+        {
+            ring->reserved = w;
+            return &ring->buf[w];
+        }
+
+        // Strictly more than a packet so write never catches up with read
+        if (r > RX_RING_PACKET)
+        {
+            ring->wrap = w;
+            COMPILER_BARRIER();
+            __atomic_store_n(&ring->write, 0U, __ATOMIC_RELEASE);
+            ring->reserved = 0;
+            return &ring->buf[0];
+        }
+
+        return NULL;
+    }
+
+    if (r - w > RX_RING_PACKET)
+    {
+        ring->reserved = w;
+        return &ring->buf[w];
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Producer: publish len bytes received into the reserved block.
+ */
+void rxRingCommit(rx_ring_t *ring, uint16_t len)
+{
+    if (len > RX_RING_PACKET)
+    {
+        len = RX_RING_PACKET;
+    }
+
+    COMPILER_BARRIER();
+    __atomic_store_n(&ring->write, (uint16_t)(ring->reserved + len), __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Consumer: next complete line without its terminator, empty lines
+ * skipped. The slice points into the ring and stays valid until the next
+ * call, which releases it.
+ * \return 0 if no complete line has arrived yet
+ */
+uint8_t rxRingGetLine(rx_ring_t *ring, slice_t *line)
+{
+    rx_view_t view;
+
+    if (ring->line_pending)
+    {
+        takeView(ring, &view);
+        release(ring, &view, ring->line_pending);
+        ring->line_pending = 0;
+    }
+
+    for (;;)
+    {
+        takeView(ring, &view);
+
+        uint16_t i = ring->scanned;
+
+        while (i < view.total)
+        {
+            uint8_t c = viewByte(ring, &view, i);
+
+            if (c == '\r' || c == '\n')
+            {
+                break;
+            }
+
+            if (!ring->discarding && i >= RX_RING_LINE_MAX)
+            {
+                ring->discarding = 1;
+                ring->line_drop_count++;
+            }
+
+            i++;
+        }
+
+        if (i == view.total)
+        {
+            if (ring->discarding)
+            {
+                release(ring, &view, i);
+                i = 0;
+            }
+
+            ring->scanned = i;
+            return 0;
+        }
+
+        ring->scanned = 0;
+
+        if (ring->discarding || i == 0)
+        {
+            ring->discarding = 0;
+            release(ring, &view, (uint16_t)(i + 1U));
+            continue;
+        }
+
+        if (i <= view.seg1)
+        {
+            line->ptr = (const char *)&ring->buf[view.read];
+        }
+        else
+        {
+            for (uint16_t k = 0; k < i; ++k)
+            {
+                ring->line_copy[k] = (char)viewByte(ring, &view, k);
+            }
+
+            line->ptr = ring->line_copy;
+        }
+
+        line->len = i;
+        ring->line_pending = (uint16_t)(i + 1U);
+        return 1;
+    }
+}
+
+uint32_t rxRingGetLineDropCount(const rx_ring_t *ring)
+{
+    return ring->line_drop_count;
+}
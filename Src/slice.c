@@ -0,0 +1,115 @@
+#include "slice.h"
+
+static uint8_t isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * \brief Split the next token off rest at delim, blanks around it trimmed.
+ * "A:1,2" gives "A" then "1,2" with ':', then "1" and "2" with ','.
+ * \return 0 once rest is used up
+ */
+uint8_t sliceNextToken(slice_t *rest, slice_t *token, char delim)
+{
+    if (!rest->ptr || !rest->len)
+    {
+        return 0;
+    }
+
+    uint16_t i = 0;
+
+    while (i < rest->len && rest->ptr[i] != delim)
+    {
+        i++;
+    }
+
+    token->ptr = rest->ptr;
+    token->len = i;
+    sliceTrim(token);
+
+    if (i < rest->len)
+    {
+        // Skip the delimiter, a trailing one leaves an empty rest
+        rest->ptr += i + 1U;
+        rest->len = (uint16_t)(rest->len - i - 1U);
+    }
+    else
+    {
+        rest->ptr += i;
+        rest->len = 0;
+    }
+
+    return 1;
+}
+
+uint8_t sliceEquals(slice_t s, const char *str)
+{
+    uint16_t i = 0;
+
+    for (; i < s.len; ++i)
+    {
+        if (str[i] != s.ptr[i])
+        {
+            return 0;
+        }
+    }
+
+    return str[i] == '\0';
+}
+
+/**
+ * \brief Decimal with an optional sign, the whole slice must be the number.
+ * \return 0 if empty, not a number or out of int32_t range
+ */
+uint8_t sliceToInt(slice_t s, int32_t *value)
+{
+    uint16_t i = 0;
+    uint8_t negative = 0;
+    uint32_t magnitude = 0;
+
+    if (s.len && (s.ptr[0] == '-' || s.ptr[0] == '+'))
+    {
+        negative = s.ptr[0] == '-';
+        i = 1;
+    }
+
+    if (i == s.len)
+    {
+        return 0;
+    }
+
+    for (; i < s.len; ++i)
+    {
+        uint32_t digit = (uint32_t)(s.ptr[i] - '0');
+
+        if (digit > 9U || magnitude > (0x80000000UL - digit) / 10U)
+        {
+            return 0;
+        }
+
+        magnitude = magnitude * 10U + digit;
+    }
+
+    if (!negative && magnitude > 0x7FFFFFFFUL)
+    {
+        return 0;
+    }
+
+    *value = negative ? (int32_t)(0U - magnitude) : (int32_t)magnitude;
+    return 1;
+}
+
+void sliceTrim(slice_t *s)
+{
+    while (s->len && isBlank(s->ptr[0]))
+    {
+        s->ptr++;
+        s->len--;
+    }
+
+    while (s->len && isBlank(s->ptr[s->len - 1U]))
+    {
+        s->len--;
+    }
+}
@@ -0,0 +1,152 @@
+#include "stall_detect.h"
+#include "string.h"
+
+static void restart(stall_detect_t *sd);
+
+
+void stallDetectInit(stall_detect_t *sd)
+{
+    memset((void *)sd, 0, sizeof(stall_detect_t));
+
+    sd->blank_samples = STALL_DETECT_BLANK;
+    sd->ratio_q8 = STALL_DETECT_RATIO_Q8;
+    sd->margin = STALL_DETECT_MARGIN;
+    sd->confirm_samples = STALL_DETECT_CONFIRM;
+    sd->level = STALL_DETECT_LEVEL;
+    sd->inrush_ratio_q8 = STALL_DETECT_INRUSH_Q8;
+    sd->shift = STALL_DETECT_SHIFT;
+}
+
+/**
+ * \brief Call when the drive starts, blanks the inrush and learns a new
+ * baseline. Takes effect with the next block of samples.
+ */
+void stallDetectArm(stall_detect_t *sd)
+{
+    sd->command = STALL_DETECT_CMD_ARM;
+}
+
+// Stop looking, e.g. while the drive is off. Also applied with the next block.
+void stallDetectDisarm(stall_detect_t *sd)
+{
+    sd->command = STALL_DETECT_CMD_DISARM;
+}
+
+/**
+ * \brief Run the detector over a block of samples, e.g. one DMA half buffer.
+ * \return 1 if the block ended in a new stall
+ */
+uint8_t stallDetectFeed(stall_detect_t *sd, const uint16_t *samples, uint16_t count)
+{
+    // The feeding interrupt cannot be preempted by the main loop, so the
+    // read and clear of the command is not torn
+    uint8_t command = sd->command;
+
+    if (command != STALL_DETECT_CMD_NONE)
+    {
+        sd->command = STALL_DETECT_CMD_NONE;
+        sd->armed = (command == STALL_DETECT_CMD_ARM);
+        restart(sd);
+    }
+
+    if (!sd->armed || sd->stalled)
+    {
+        return 0;
+    }
+
+    for (uint16_t i = 0; i < count; ++i)
+    {
+        uint32_t x = samples[i];
+
+        if (sd->blank_left)
+        {
+            sd->blank_left--;
+
+            if (x > sd->inrush_peak)
+            {
+                sd->inrush_peak = (uint16_t)x;
+            }
+            continue;
+        }
+
+        if (!sd->seeded)
+        {
+            // Started against an end stop the current never drops from the
+            // inrush, seeding the baseline there would hide the stall
+            if (sd->inrush_ratio_q8 && sd->inrush_peak > sd->margin &&
+                x >= ((uint32_t)sd->inrush_peak * sd->inrush_ratio_q8 >> 8))
+            {
+                if (x > sd->peak)
+                {
+                    sd->peak = (uint16_t)x;
+                }
+
+                if (++sd->over_count >= sd->confirm_samples)
+                {
+                    sd->stalled = 1;
+                    return 1;
+                }
+                continue;
+            }
+
+            sd->over_count = 0;
+            sd->baseline_q8 = x << 8;
+            sd->seeded = 1;
+            continue;
+        }
+
+        uint32_t threshold = ((sd->baseline_q8 >> 8) * sd->ratio_q8 >> 8) + sd->margin;
+
+        if (x > threshold || (sd->level && x >= sd->level))
+        {
+            if (x > sd->peak)
+            {
+                sd->peak = (uint16_t)x;
+            }
+
+            if (++sd->over_count >= sd->confirm_samples)
+            {
+                sd->stalled = 1;
+                return 1;
+            }
+
+            // Spikes do not pull the baseline up
+            continue;
+        }
+
+        sd->over_count = 0;
+        uint32_t x_q8 = x << 8;
+
+        if (x_q8 >= sd->baseline_q8)
+        {
+            sd->baseline_q8 += (x_q8 - sd->baseline_q8) >> sd->shift;
+        }
+        else
+        {
+            sd->baseline_q8 -= (sd->baseline_q8 - x_q8) >> sd->shift;
+        }
+    }
+
+    return 0;
+}
+
+uint8_t stallDetectIsStalled(const stall_detect_t *sd)
+{
+    return sd->stalled;
+}
+
+uint16_t stallDetectGetBaseline(const stall_detect_t *sd)
+{
+    return (uint16_t)(sd->baseline_q8 >> 8);
+}
+
+
+static void restart(stall_detect_t *sd)
+{
+    sd->blank_left = sd->blank_samples;
+    sd->over_count = 0;
+    sd->inrush_peak = 0;
+    sd->seeded = 0;
+    sd->stalled = 0;
+    sd->peak = 0;
+}
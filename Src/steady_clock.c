@@ -6,10 +6,81 @@
  */
 
 #include "steady_clock.h"
+
+#ifdef STEADY_CLOCK_HOST
+#include <time.h>
+#else
 #include "main.h"
+#endif
+
+static steady_clock_scale_t usec_scale;
+static steady_clock_scale_t nsec_scale;
+static uint32_t frequency = 1;
+
+static void scaleInit(steady_clock_scale_t *scale, uint32_t units_per_sec, uint32_t cycles_per_sec);
+static uint64_t scaleApply(const steady_clock_scale_t *scale, uint64_t cycles);
+static uint64_t mulHigh64(uint64_t a, uint64_t b);
+
+#ifdef STEADY_CLOCK_HOST
+
+static uint8_t host_virtual;
+static uint64_t host_cycles;
 
 void steadyClockEnable(void)
 {
+   if (!host_virtual)
+   {
+      frequency = 1000000000u;
+   }
+
+   scaleInit(&usec_scale, 1000000u, frequency);
+   scaleInit(&nsec_scale, 1000000000u, frequency);
+}
+
+void steadyClockTick(void)
+{
+}
+
+uint64_t steadyClockCycles64(void)
+{
+   if (host_virtual)
+   {
+      return host_cycles;
+   }
+
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Switch to a virtual clock of the given frequency, starting at cycle 0
+void steadyClockHostSetVirtual(uint32_t virtual_frequency)
+{
+   host_virtual = 1;
+   host_cycles = 0;
+   frequency = virtual_frequency ? virtual_frequency : 1;
+   steadyClockEnable();
+}
+
+void steadyClockHostAdvance(uint64_t cycles)
+{
+   host_cycles += cycles;
+}
+
+#else
+
+// Wrap count << 1 | MSB of the last CYCCNT seen, one word so that readers
+// at any priority see the extension and the MSB from the same tick
+static volatile uint32_t cyccnt_ext;
+
+void steadyClockEnable(void)
+{
+   frequency = SystemCoreClock;
+   scaleInit(&usec_scale, 1000000u, frequency);
+   scaleInit(&nsec_scale, 1000000000u, frequency);
+   cyccnt_ext = 0u;
+
 //24.Bit TRCENA in Debug Exception and Monitor Control Register must be set before enable DWT
    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
 // CYCCNT is a free running counter, counting upwards.32 bits. 2^32 / cpuFreq = max time
@@ -17,7 +88,132 @@ void steadyClockEnable(void)
    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;// Enable the CYCCNT counter.
 }
 
-float getusec(void)
+/**
+ * \brief Call from SysTick_Handler. Has to run at least twice per CYCCNT
+ * period (~25 s at 168 MHz) to catch every wrap.
+ */
+void steadyClockTick(void)
+{
+   uint32_t msb = DWT->CYCCNT >> 31;
+   uint32_t ext = cyccnt_ext;
+
+   if ((ext & 1u) && !msb)
+   {
+      ext += 2u;
+   }
+
+   cyccnt_ext = (ext & ~1u) | msb;
+}
+
+uint64_t steadyClockCycles64(void)
+{
+   // Extension first: a tick between the two reads only makes it older,
+   // which the MSB compare below still corrects
+   uint32_t ext = cyccnt_ext;
+   uint32_t now = DWT->CYCCNT;
+   uint32_t wraps = ext >> 1;
+
+   if ((ext & 1u) && !(now >> 31))
+   {
+      wraps++;
+   }
+
+   return ((uint64_t)wraps << 32) | now;
+}
+
+#endif
+
+uint64_t steadyClockUsec64(void)
+{
+   return scaleApply(&usec_scale, steadyClockCycles64());
+}
+
+// Up to 1 ns low when the core clock is not a divisor of 1 GHz
+uint64_t steadyClockNsec64(void)
+{
+   return scaleApply(&nsec_scale, steadyClockCycles64());
+}
+
+uint64_t steadyClockCyclesToUsec(uint64_t cycles)
+{
+   return scaleApply(&usec_scale, cycles);
+}
+
+uint64_t steadyClockCyclesToNsec(uint64_t cycles)
+{
+   return scaleApply(&nsec_scale, cycles);
+}
+
+uint32_t steadyClockFrequency(void)
+{
+   return frequency;
+}
+
+uint32_t steadyClockCycles(void)
 {
-   return DWT->CYCCNT / (float)(SystemCoreClock / 1000000);
+   return (uint32_t)steadyClockCycles64();
+}
+
+// Low 32 bits of steadyClockUsec64(), wraps after ~71 minutes
+uint32_t steadyClockUsec(void)
+{
+   return (uint32_t)steadyClockUsec64();
+}
+
+/**
+ * \brief Map a raw 32 bit cycle stamp taken in the past (e.g. in an ISR) onto
+ * the steadyClockUsec() time line. The stamp must be younger than one CYCCNT period.
+ */
+uint32_t steadyClockStampToUsec(uint32_t cycle_stamp)
+{
+   uint64_t now = steadyClockCycles64();
+   uint32_t age_cycles = (uint32_t)now - cycle_stamp;
+
+   return (uint32_t)scaleApply(&usec_scale, now - age_cycles);
+}
+
+
+// units / cycle as whole + frac / 2^64, by long division so no 128 bit type is needed
+static void scaleInit(steady_clock_scale_t *scale, uint32_t units_per_sec, uint32_t cycles_per_sec)
+{
+   uint64_t rem = units_per_sec % cycles_per_sec;
+   uint64_t frac = 0;
+
+   scale->whole = units_per_sec / cycles_per_sec;
+
+   for (uint8_t i = 0; i < 2; ++i)
+   {
+      rem <<= 32;
+      frac = (frac << 32) | (rem / cycles_per_sec);
+      rem %= cycles_per_sec;
+   }
+
+   scale->frac = frac;
+   scale->divisor = (cycles_per_sec % units_per_sec) ? 0 : cycles_per_sec / units_per_sec;
+}
+
+// floor(cycles * scale), at most one unit low, never decreasing in cycles
+static uint64_t scaleApply(const steady_clock_scale_t *scale, uint64_t cycles)
+{
+   uint64_t units = cycles * scale->whole + mulHigh64(cycles, scale->frac);
+
+   // Integer cycles per unit (e.g. 168 per us): one step makes it exact
+   if (scale->divisor && cycles - units * scale->divisor >= scale->divisor)
+   {
+      units++;
+   }
+
+   return units;
+}
+
+static uint64_t mulHigh64(uint64_t a, uint64_t b)
+{
+   uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+   uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+   uint64_t lo_lo = a_lo * b_lo;
+   uint64_t hi_lo = a_hi * b_lo;
+   uint64_t lo_hi = a_lo * b_hi;
+   uint64_t mid = (lo_lo >> 32) + (uint32_t)hi_lo + (uint32_t)lo_hi;
+
+   return a_hi * b_hi + (hi_lo >> 32) + (lo_hi >> 32) + (mid >> 32);
 }
@@ -0,0 +1,297 @@
+#include "timer_wheel.h"
+#include "string.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define SLOT_DETACHED 0xFF  // on the list being expired, not in the wheel
+
+#if TIMER_WHEEL_SLOTS > 32 || TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS > SLOT_DETACHED
+#error "timer wheel geometry does not fit the occupied masks"
+#endif
+
+static void link(timer_wheel_t *tw, wheel_timer_t *timer);
+static void unlink(timer_wheel_t *tw, wheel_timer_t *timer);
+static void cascade(timer_wheel_t *tw, uint8_t level);
+static void expire(timer_wheel_t *tw, wheel_timer_t *list);
+static uint8_t slotDistance(uint32_t occupied, uint32_t index);
+
+
+void timerWheelInit(timer_wheel_t *tw, uint32_t now)
+{
+    memset((void *)tw, 0, sizeof(timer_wheel_t));
+    tw->now = now;
+}
+
+void timerWheelSetCallback(wheel_timer_t *timer, wheel_timer_callback_t callback, void *context)
+{
+    timer->callback = callback;
+    timer->context = context;
+}
+
+/**
+ * \brief (Re)start a timer, a running one is moved to its new expiry.
+ * \param delay - ticks from the wheel's current tick, 0 fires on the next one
+ * \param period - reload after each expiry, 0 for a one shot
+ */
+void timerWheelStart(timer_wheel_t *tw, wheel_timer_t *timer, uint32_t delay, uint32_t period)
+{
+    if (timer->pprev)
+    {
+        unlink(tw, timer);
+    }
+
+    if (delay == 0)
+    {
+        delay = 1;
+    }
+    else if (delay > TIMER_WHEEL_MAX_DELAY)
+    {
+        delay = TIMER_WHEEL_MAX_DELAY;
+    }
+
+    timer->expires = tw->now + delay;
+    timer->period = period > TIMER_WHEEL_MAX_DELAY ? TIMER_WHEEL_MAX_DELAY : period;
+    timer->expired = 0;
+    link(tw, timer);
+}
+
+void timerWheelCancel(timer_wheel_t *tw, wheel_timer_t *timer)
+{
+    if (timer->pprev)
+    {
+        unlink(tw, timer);
+    }
+
+    timer->expired = 0;
+}
+
+uint8_t timerWheelIsActive(const wheel_timer_t *timer)
+{
+    return timer->pprev != 0;
+}
+
+// Read and clear the expiry flag, for timers polled without a callback
+uint8_t timerWheelExpired(wheel_timer_t *timer)
+{
+    uint8_t expired = timer->expired;
+
+    timer->expired = 0;
+    return expired;
+}
+
+/**
+ * \brief Run every timer due up to now. Stretches without level 0 timers
+ * are skipped a whole slot revolution at a time.
+ * \param now - system tick continuously running
+ */
+void timerWheelAdvance(timer_wheel_t *tw, uint32_t now)
+{
+    while (tw->now != now)
+    {
+        if (!tw->occupied[0])
+        {
+            uint32_t to_boundary = TIMER_WHEEL_SLOTS - (tw->now & SLOT_MASK);
+
+            if ((uint32_t)(now - tw->now) < to_boundary)
+            {
+                tw->now = now;
+                break;
+            }
+
+            tw->now += to_boundary - 1;
+        }
+
+        tw->now++;
+
+        uint32_t index = tw->now & SLOT_MASK;
+
+        if (index == 0)
+        {
+            cascade(tw, 1);
+        }
+
+        wheel_timer_t *list = tw->slot[0][index];
+
+        if (list)
+        {
+            tw->slot[0][index] = 0;
+            tw->occupied[0] &= ~(1UL << index);
+            expire(tw, list);
+        }
+    }
+}
+
+/**
+ * \brief Earliest tick the wheel has work at. Exact for level 0, otherwise
+ * the tick a slot is cascaded at, which is never later than its timers.
+ * \return 0 if no timer is running
+ */
+uint8_t timerWheelNextExpiry(const timer_wheel_t *tw, uint32_t *deadline)
+{
+    uint8_t found = 0;
+    uint32_t best = 0;
+
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; ++level)
+    {
+        if (!tw->occupied[level])
+        {
+            continue;
+        }
+
+        uint8_t shift = (uint8_t)(level * TIMER_WHEEL_BITS);
+        uint32_t block = tw->now >> shift;
+        uint32_t at = (block + slotDistance(tw->occupied[level], block & SLOT_MASK)) << shift;
+
+        if (!found || (int32_t)(at - best) < 0)
+        {
+            best = at;
+            found = 1;
+        }
+    }
+
+    if (found)
+    {
+        *deadline = best;
+    }
+
+    return found;
+}
+
+
+static void link(timer_wheel_t *tw, wheel_timer_t *timer)
+{
+    uint32_t delta = timer->expires - tw->now;
+    uint8_t level = 0;
+
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1UL << (TIMER_WHEEL_BITS * (level + 1))))
+    {
+        level++;
+    }
+
+    uint32_t index = (timer->expires >> (level * TIMER_WHEEL_BITS)) & SLOT_MASK;
+    wheel_timer_t **head = &tw->slot[level][index];
+
+    timer->next = *head;
+    if (timer->next)
+    {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    timer->slot = (uint8_t)(level * TIMER_WHEEL_SLOTS + index);
+    *head = timer;
+    tw->occupied[level] |= 1UL << index;
+}
+
+static void unlink(timer_wheel_t *tw, wheel_timer_t *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next)
+    {
+        timer->next->pprev = timer->pprev;
+    }
+
+    if (timer->slot != SLOT_DETACHED)
+    {
+        uint8_t level = timer->slot / TIMER_WHEEL_SLOTS;
+        uint8_t index = timer->slot & SLOT_MASK;
+
+        if (!tw->slot[level][index])
+        {
+            tw->occupied[level] &= ~(1UL << index);
+        }
+    }
+
+    timer->next = 0;
+    timer->pprev = 0;
+}
+
+// Re-sort one slot of a higher level into the levels below
+static void cascade(timer_wheel_t *tw, uint8_t level)
+{
+    if (level >= TIMER_WHEEL_LEVELS)
+    {
+        return;
+    }
+
+    uint32_t index = (tw->now >> (level * TIMER_WHEEL_BITS)) & SLOT_MASK;
+
+    if (index == 0)
+    {
+        cascade(tw, (uint8_t)(level + 1));
+    }
+
+    wheel_timer_t *list = tw->slot[level][index];
+
+    tw->slot[level][index] = 0;
+    tw->occupied[level] &= ~(1UL << index);
+
+    while (list)
+    {
+        wheel_timer_t *timer = list;
+
+        list = timer->next;
+        timer->next = 0;
+        timer->pprev = 0;
+        link(tw, timer);
+    }
+}
+
+static void expire(timer_wheel_t *tw, wheel_timer_t *list)
+{
+    // The slot is detached first, callbacks may start or cancel any timer,
+    // including the ones still waiting on this list
+    for (wheel_timer_t *timer = list; timer; timer = timer->next)
+    {
+        timer->slot = SLOT_DETACHED;
+    }
+
+    if (list)
+    {
+        list->pprev = &list;
+    }
+
+    while (list)
+    {
+        wheel_timer_t *timer = list;
+
+        list = timer->next;
+        if (list)
+        {
+            list->pprev = &list;
+        }
+        timer->next = 0;
+        timer->pprev = 0;
+
+        if (timer->period)
+        {
+            timer->expires += timer->period;
+
+            // Late by a whole period or more: keep the rate, drop the phase
+            if ((int32_t)(timer->expires - tw->now) <= 0)
+            {
+                timer->expires = tw->now + timer->period;
+            }
+
+            link(tw, timer);
+        }
+
+        timer->expired = 1;
+
+        if (timer->callback)
+        {
+            timer->callback(timer, timer->context);
+        }
+    }
+}
+
+// Slots from index to the next occupied one, a full turn if only index is
+static uint8_t slotDistance(uint32_t occupied, uint32_t index)
+{
+    uint32_t ahead = index == SLOT_MASK ? 0 : occupied >> (index + 1);
+
+    if (ahead)
+    {
+        return (uint8_t)(__builtin_ctz(ahead) + 1);
+    }
+
+    return (uint8_t)(TIMER_WHEEL_SLOTS - index + __builtin_ctz(occupied));
+}
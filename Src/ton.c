@@ -1,7 +1,14 @@
 #include "ton.h"
+#include "string.h"
 
 #define TIME_OVER(target,time) ((uint32_t)((time) - (target)) < 0x80000000U)
 
+#define TON_BANK_MASK ((uint32_t)((1ULL << TON_BANK_CHANNELS) - 1))
+
+#if TON_BANK_CHANNELS > 32
+#error "TON_BANK_CHANNELS must fit a 32 bit mask"
+#endif
+
 /**
  * \fn bool TON(uint8_t id, uint8_t in, uint32_t now, uint32_t preset_time)
  * \brief Start a timer with a specified duration as on-delay.
@@ -34,3 +41,78 @@ uint8_t TON(ton_t *obj, uint8_t in, uint32_t now, uint32_t preset_time)
 
 	return ret_val;
 }
+
+void tonBankInit(ton_bank_t *bank)
+{
+	memset(bank, 0, sizeof(ton_bank_t));
+}
+
+// Takes effect the next time the channel starts
+void tonBankSetPreset(ton_bank_t *bank, uint8_t channel, uint32_t preset_time)
+{
+	if (channel < TON_BANK_CHANNELS)
+	{
+		bank->preset[channel] = preset_time;
+	}
+}
+
+/**
+ * \brief TON() on every channel of the bank at once.
+ * \param inputs - bit per channel, a channel starts on 0 -> 1 and resets on 0
+ * \param now - system tick continuously running
+ * \return mask of the channels whose time is over
+ */
+uint32_t tonBankUpdate(ton_bank_t *bank, uint32_t inputs, uint32_t now)
+{
+	inputs &= TON_BANK_MASK;
+
+	uint32_t starting = inputs & ~bank->running;
+	uint32_t pending = bank->running & inputs & ~bank->done;
+
+	bank->running = inputs;
+	bank->done &= inputs;
+
+	// Only look at the timing channels once the earliest of them is due,
+	// like TON() a channel is not done on the pass it starts
+	if (pending && TIME_OVER(bank->next, now))
+	{
+		uint32_t next = now + 0x7FFFFFFFU;
+		uint32_t scan = pending;
+
+		while (scan)
+		{
+			uint8_t i = (uint8_t)__builtin_ctz(scan);
+			scan &= scan - 1;
+
+			if (TIME_OVER(bank->since[i], now))
+			{
+				bank->done |= 1UL << i;
+			}
+			else if ((int32_t)(bank->since[i] - next) < 0)
+			{
+				next = bank->since[i];
+			}
+		}
+
+		bank->next = next;
+	}
+
+	uint32_t timing = pending & ~bank->done;
+
+	while (starting)
+	{
+		uint8_t i = (uint8_t)__builtin_ctz(starting);
+		starting &= starting - 1;
+
+		bank->since[i] = now + bank->preset[i];
+
+		if (!timing || (int32_t)(bank->since[i] - bank->next) < 0)
+		{
+			bank->next = bank->since[i];
+		}
+
+		timing |= 1UL << i;
+	}
+
+	return bank->done;
+}
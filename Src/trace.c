@@ -0,0 +1,147 @@
+#include "trace.h"
+#include "string.h"
+
+#define TRACE_MASK (TRACE_BUFFER_SIZE - 1U)
+
+#if (TRACE_BUFFER_SIZE & TRACE_MASK) != 0
+#error "TRACE_BUFFER_SIZE must be a power of two"
+#endif
+
+#define COMPILER_BARRIER() __asm volatile ("" ::: "memory")
+
+static uint16_t crc16(const uint8_t *data, uint16_t len);
+
+
+void traceInit(trace_t *trace, uint32_t (*timestamp)(void))
+{
+    memset((void *)trace, 0, sizeof(trace_t));
+
+    for (uint32_t i = 0; i < TRACE_BUFFER_SIZE; ++i)
+    {
+        trace->slot[i].seq = i;
+    }
+
+    trace->timestamp = timestamp;
+}
+
+/**
+ * \brief Add a record from any context. A slot is claimed with one CAS on the
+ * head, then published through its sequence number.
+ */
+void traceRecord(trace_t *trace, trace_type_t type, uint8_t source, uint16_t arg16, uint32_t arg32)
+{
+    uint32_t pos = trace->head;
+    trace_slot_t *slot;
+
+    for (;;)
+    {
+        slot = &trace->slot[pos & TRACE_MASK];
+        int32_t diff = (int32_t)(slot->seq - pos);
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&trace->head, &pos, pos + 1U, 0,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // Consumer has not freed this slot yet
+            __atomic_fetch_add(&trace->drop_count, 1U, __ATOMIC_RELAXED);
+            return;
+        }
+        else
+        {
+            pos = trace->head;
+        }
+    }
+
+    slot->record.timestamp = trace->timestamp ? trace->timestamp() : 0;
+    slot->record.arg32 = arg32;
+    slot->record.arg16 = arg16;
+    slot->record.type = (uint8_t)type;
+    slot->record.source = source;
+
+    COMPILER_BARRIER();
+    slot->seq = pos + 1U;
+}
+
+uint8_t tracePop(trace_t *trace, trace_record_t *record)
+{
+    trace_slot_t *slot = &trace->slot[trace->tail & TRACE_MASK];
+
+    if (slot->seq != trace->tail + 1U)
+    {
+        return 0;
+    }
+
+    COMPILER_BARRIER();
+    *record = slot->record;
+
+    COMPILER_BARRIER();
+    slot->seq = trace->tail + TRACE_BUFFER_SIZE;
+    trace->tail++;
+
+    return 1;
+}
+
+uint32_t traceGetDropCount(const trace_t *trace)
+{
+    return trace->drop_count;
+}
+
+/**
+ * \brief Pack up to TRACE_RECORDS_PER_PACKET records behind a 4 byte header
+ * (0xA5, 'R', count, seq), records are little endian trace_record_t. A
+ * little endian CRC-16/CCITT-FALSE over header and records follows.
+ * \param packet - at least TRACE_PACKET_SIZE bytes
+ * \return packet length, 0 if there was nothing to send
+ */
+uint16_t traceFillPacket(trace_t *trace, uint8_t *packet, uint8_t seq)
+{
+    uint8_t count = 0;
+    trace_record_t record;
+
+    while (count < TRACE_RECORDS_PER_PACKET && tracePop(trace, &record))
+    {
+        memcpy(&packet[4 + count * sizeof(trace_record_t)], &record, sizeof(trace_record_t));
+        count++;
+    }
+
+    if (!count)
+    {
+        return 0;
+    }
+
+    packet[0] = TRACE_PACKET_MAGIC0;
+    packet[1] = TRACE_PACKET_MAGIC1;
+    packet[2] = count;
+    packet[3] = seq;
+
+    uint16_t len = (uint16_t)(4 + count * sizeof(trace_record_t));
+    uint16_t crc = crc16(packet, len);
+
+    packet[len] = (uint8_t)crc;
+    packet[len + 1] = (uint8_t)(crc >> 8);
+
+    return (uint16_t)(len + 2);
+}
+
+static uint16_t crc16(const uint8_t *data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)(*data++ << 8);
+
+        for (uint8_t bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
@@ -0,0 +1,27 @@
+#include "trace.h"
+#include "cdc_tx.h"
+
+static uint8_t trace_packet[TRACE_PACKET_SIZE];
+static uint8_t trace_packet_seq;
+
+/**
+ * \brief Queue the trace on the shared CDC transmit ring one packet at a
+ * time, call from the main loop. Records stay in the trace while the ring
+ * has no room for a whole packet. A packet is written in one piece, so
+ * print() text only ever lands between packets.
+ */
+void traceDrainCdc(trace_t *trace)
+{
+    while (cdcTxGetFree() >= sizeof(trace_packet))
+    {
+        uint16_t len = traceFillPacket(trace, trace_packet, trace_packet_seq);
+
+        if (!len)
+        {
+            return;
+        }
+
+        cdcTxWrite(trace_packet, len);
+        trace_packet_seq++;
+    }
+}
@@ -0,0 +1,146 @@
+#include "tx_ring.h"
+#include "string.h"
+
+#define TX_RING_MASK (TX_RING_SIZE - 1U)
+
+#if (TX_RING_SIZE & TX_RING_MASK) != 0
+#error "TX_RING_SIZE must be a power of two"
+#endif
+
+#define COMPILER_BARRIER() __asm volatile ("" ::: "memory")
+
+
+void txRingInit(tx_ring_t *ring)
+{
+    memset((void *)ring, 0, sizeof(tx_ring_t));
+}
+
+/**
+ * \brief Queue a message from any context, all of it or nothing.
+ * \return 0 if it did not fit and was dropped
+ */
+uint8_t txRingWrite(tx_ring_t *ring, const void *data, uint16_t len)
+{
+    uint32_t need = (uint32_t)len + TX_RING_HEADER;
+    uint32_t pos = ring->head;
+
+    if (!len)
+    {
+        return 1;
+    }
+
+    do
+    {
+        if ((uint32_t)(pos + need - ring->tail) > TX_RING_SIZE)
+        {
+            __atomic_fetch_add(&ring->drop_count, 1U, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&ring->drop_bytes, len, __ATOMIC_RELAXED);
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&ring->head, &pos, pos + need, 0,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    const uint8_t *src = (const uint8_t *)data;
+
+    ring->buf[pos & TX_RING_MASK] = (uint8_t)len;
+    ring->buf[(pos + 1U) & TX_RING_MASK] = (uint8_t)(len >> 8);
+
+    for (uint32_t i = 0; i < len; ++i)
+    {
+        ring->buf[(pos + TX_RING_HEADER + i) & TX_RING_MASK] = src[i];
+    }
+
+    COMPILER_BARRIER();
+    __atomic_store_n(&ring->buf[(pos + 2U) & TX_RING_MASK], 1U, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/**
+ * \brief Take up to max bytes of committed messages, a message may be split
+ * across calls. Single reader, e.g. the USB transmit complete callback.
+ * \return bytes copied to out
+ */
+uint16_t txRingRead(tx_ring_t *ring, uint8_t *out, uint16_t max)
+{
+    uint16_t count = 0;
+    uint32_t tail = ring->tail;
+
+    while (count < max && tail != ring->head)
+    {
+        if (!__atomic_load_n(&ring->buf[(tail + 2U) & TX_RING_MASK], __ATOMIC_ACQUIRE))
+        {
+            // Claimed but still being written
+            break;
+        }
+
+        uint16_t len = (uint16_t)(ring->buf[tail & TX_RING_MASK]
+                                  | (ring->buf[(tail + 1U) & TX_RING_MASK] << 8));
+        uint16_t take = (uint16_t)(len - ring->offset);
+
+        if (take > max - count)
+        {
+            take = (uint16_t)(max - count);
+        }
+
+        uint32_t from = tail + TX_RING_HEADER + ring->offset;
+
+        for (uint16_t i = 0; i < take; ++i)
+        {
+            out[count++] = ring->buf[(from + i) & TX_RING_MASK];
+        }
+
+        ring->offset = (uint16_t)(ring->offset + take);
+
+        if (ring->offset < len)
+        {
+            break;
+        }
+
+        // Zero the whole message so a later header here starts uncommitted
+        uint32_t end = tail + TX_RING_HEADER + len;
+
+        for (uint32_t i = tail; i != end; ++i)
+        {
+            ring->buf[i & TX_RING_MASK] = 0;
+        }
+
+        ring->offset = 0;
+        tail = end;
+
+        COMPILER_BARRIER();
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    return count;
+}
+
+uint8_t txRingIsEmpty(const tx_ring_t *ring)
+{
+    return ring->tail == ring->head;
+}
+
+/**
+ * \brief Largest message that would fit right now, a lower bound once other
+ * writers are active.
+ */
+uint16_t txRingGetFree(const tx_ring_t *ring)
+{
+    uint32_t used = ring->head - ring->tail;
+
+    if (used + TX_RING_HEADER >= TX_RING_SIZE)
+    {
+        return 0;
+    }
+
+    return (uint16_t)(TX_RING_SIZE - used - TX_RING_HEADER);
+}
+
+uint32_t txRingGetDropCount(const tx_ring_t *ring)
+{
+    return ring->drop_count;
+}
+
+uint32_t txRingGetDropBytes(const tx_ring_t *ring)
+{
+    return ring->drop_bytes;
+}
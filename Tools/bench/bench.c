@@ -0,0 +1,381 @@
+#include "bench.h"
+#include "string.h"
+#include "ton.h"
+#include "edge_detection.h"
+#include "homing.h"
+#include "steady_clock.h"
+#include "fmt.h"
+#include "stdio.h"
+
+#ifdef BENCH_HOST
+#include <stdio.h>
+
+// steady_clock's host backend counts 1 GHz cycles, i.e. ns
+#define BENCH_UNIT      "ns"
+#define BENCH_PRINT     printf
+#define BENCH_BATCH     64
+#define BENCH_ROUNDS    2000
+#else
+#include "retarget.h"
+
+#define BENCH_UNIT      "cycles"
+#define BENCH_PRINT     print
+#define BENCH_BATCH     8
+#define BENCH_ROUNDS    200
+#endif
+
+#define benchNow        steadyClockCycles
+
+#define BENCH_NOW       100000U
+
+typedef struct
+{
+    uint32_t min_x100;
+    uint32_t sum_x100;
+    uint32_t rounds;
+    uint32_t calls;
+} bench_result_t;
+
+typedef struct
+{
+    const char *name;
+    homing_state_t state;
+    uint8_t entry;          // first pass in the state
+    uint8_t retract;
+    uint8_t extend;
+    uint8_t active;
+} homing_case_t;
+
+static const homing_case_t homing_cases[] =
+{
+    { "idle",                 HOMING_STATE_IDLE,                 0, 0, 0, 0 },
+    { "init",                 HOMING_STATE_INIT,                 1, 0, 0, 1 },
+    { "to_retract_entry",     HOMING_STATE_MOVE_TO_RETRACT_LIMIT, 1, 0, 0, 1 },
+    { "to_retract",           HOMING_STATE_MOVE_TO_RETRACT_LIMIT, 0, 0, 0, 1 },
+    { "to_retract_contact",   HOMING_STATE_MOVE_TO_RETRACT_LIMIT, 0, 1, 0, 1 },
+    { "settle_retract",       HOMING_STATE_SETTLE_AT_RETRACT,    0, 1, 0, 1 },
+    { "measure_extend_entry", HOMING_STATE_MEASURE_EXTEND,       1, 0, 0, 1 },
+    { "measure_extend",       HOMING_STATE_MEASURE_EXTEND,       0, 0, 0, 1 },
+    { "measure_extend_contact", HOMING_STATE_MEASURE_EXTEND,     0, 0, 1, 1 },
+    { "settle_extend",        HOMING_STATE_SETTLE_AT_EXTEND,     0, 0, 1, 1 },
+    { "measure_retract",      HOMING_STATE_MEASURE_RETRACT,      0, 0, 0, 1 },
+    { "settle_retract_2",     HOMING_STATE_SETTLE_AT_RETRACT_2,  0, 1, 0, 1 },
+    { "to_center",            HOMING_STATE_MOVE_TO_CENTER,       0, 0, 0, 1 },
+    { "complete",             HOMING_STATE_COMPLETE,             1, 0, 0, 1 },
+    { "error_retry",          HOMING_STATE_ERROR,                1, 0, 0, 1 },
+};
+
+static uint8_t stub_retract;
+static uint8_t stub_extend;
+static volatile uint32_t sink;
+
+static ton_t ton_batch[BENCH_BATCH];
+static edge_detection_t ed_batch[BENCH_BATCH];
+static homing_t homing_batch[BENCH_BATCH];
+
+static void benchTon(void);
+static void benchEdge(void);
+static void benchHoming(void);
+static void benchBaseline(void);
+static void benchFormat(void);
+static void prepareHoming(homing_t *homing, const homing_case_t *hc);
+static void resultAdd(bench_result_t *result, uint32_t elapsed, uint32_t calls);
+static void report(const char *suite, const char *name, const bench_result_t *result);
+static void emptyCall(void *obj, uint8_t in);
+
+static void stubSetDirection(actuator_direction_t dir) { (void)dir; }
+static uint8_t stubReadRetract(void) { return stub_retract; }
+static uint8_t stubReadExtend(void) { return stub_extend; }
+static uint32_t stubGetSysTick(void) { return BENCH_NOW; }
+
+static const homing_funcs_t stub_funcs =
+{
+    .setActuatorDirection = stubSetDirection,
+    .readRetractSwitch = stubReadRetract,
+    .readExtendSwitch = stubReadExtend,
+    .getSysTick = stubGetSysTick
+};
+
+// Called through a pointer so the baseline keeps the call
+static void (*volatile empty_call)(void *obj, uint8_t in) = emptyCall;
+
+
+void benchRunAll(void)
+{
+    BENCH_PRINT("BENCH,suite,case,unit,min,mean,calls\r\n");
+
+    benchBaseline();
+    benchTon();
+    benchEdge();
+    benchHoming();
+    benchFormat();
+}
+
+#ifdef BENCH_HOST
+int main(void)
+{
+    steadyClockEnable();
+    benchRunAll();
+    return 0;
+}
+#endif
+
+
+static void benchBaseline(void)
+{
+    bench_result_t result;
+
+    memset(&result, 0, sizeof(result));
+
+    for (uint32_t r = 0; r < BENCH_ROUNDS; ++r)
+    {
+        uint32_t t0 = benchNow();
+
+        for (uint32_t i = 0; i < BENCH_BATCH; ++i)
+        {
+            empty_call(&ton_batch[i], 1);
+        }
+
+        resultAdd(&result, benchNow() - t0, BENCH_BATCH);
+    }
+
+    report("baseline", "empty_call", &result);
+}
+
+static void benchTon(void)
+{
+    // in, aux, since relative to now
+    static const struct { const char *name; uint8_t in; uint32_t aux; int32_t since; } cases[] =
+    {
+        { "in_low",   0, 1, 1000 },
+        { "start",    1, 0, 0 },
+        { "running",  1, 1, 1000 },
+        { "expired",  1, 1, -1 },
+    };
+
+    for (uint32_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c)
+    {
+        bench_result_t result;
+        uint32_t hits = 0;
+
+        memset(&result, 0, sizeof(result));
+
+        for (uint32_t r = 0; r < BENCH_ROUNDS; ++r)
+        {
+            for (uint32_t i = 0; i < BENCH_BATCH; ++i)
+            {
+                ton_batch[i].aux = cases[c].aux;
+                ton_batch[i].since = BENCH_NOW + (uint32_t)cases[c].since;
+            }
+
+            uint32_t t0 = benchNow();
+
+            for (uint32_t i = 0; i < BENCH_BATCH; ++i)
+            {
+                hits += TON(&ton_batch[i], cases[c].in, BENCH_NOW, 1000);
+            }
+
+            resultAdd(&result, benchNow() - t0, BENCH_BATCH);
+        }
+
+        sink = hits;
+        report("ton", cases[c].name, &result);
+    }
+}
+
+static void benchEdge(void)
+{
+    static const struct { const char *name; uint8_t in; uint32_t aux; } cases[] =
+    {
+        { "low",     0, 0 },
+        { "high",    1, 1 },
+        { "rising",  1, 0 },
+        { "falling", 0, 1 },
+    };
+
+    for (uint32_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c)
+    {
+        bench_result_t result;
+        uint32_t hits = 0;
+
+        memset(&result, 0, sizeof(result));
+
+        for (uint32_t r = 0; r < BENCH_ROUNDS; ++r)
+        {
+            for (uint32_t i = 0; i < BENCH_BATCH; ++i)
+            {
+                ed_batch[i].aux = cases[c].aux;
+            }
+
+            uint32_t t0 = benchNow();
+
+            for (uint32_t i = 0; i < BENCH_BATCH; ++i)
+            {
+                hits += edgeDetection(&ed_batch[i], cases[c].in);
+            }
+
+            resultAdd(&result, benchNow() - t0, BENCH_BATCH);
+        }
+
+        sink = hits;
+        report("edge", cases[c].name, &result);
+    }
+}
+
+// One homingProcess() pass per snapshot, snapshots are rebuilt untimed
+static void benchHoming(void)
+{
+    for (uint32_t c = 0; c < sizeof(homing_cases) / sizeof(homing_cases[0]); ++c)
+    {
+        const homing_case_t *hc = &homing_cases[c];
+        bench_result_t result;
+
+        memset(&result, 0, sizeof(result));
+
+        stub_retract = hc->retract;
+        stub_extend = hc->extend;
+
+        prepareHoming(&homing_batch[0], hc);
+
+        for (uint32_t r = 0; r < BENCH_ROUNDS; ++r)
+        {
+            for (uint32_t i = 1; i < BENCH_BATCH; ++i)
+            {
+                homing_batch[i] = homing_batch[0];
+            }
+
+            uint32_t t0 = benchNow();
+
+            for (uint32_t i = 1; i < BENCH_BATCH; ++i)
+            {
+                homingProcess(&homing_batch[i]);
+            }
+
+            // Slot 0 holds the template
+            resultAdd(&result, benchNow() - t0, BENCH_BATCH - 1);
+        }
+
+        report("homing", hc->name, &result);
+    }
+}
+
+// A pass in the middle of hc->state: timers running, switches debounced
+static void prepareHoming(homing_t *homing, const homing_case_t *hc)
+{
+    homingInit(homing, &stub_funcs);
+
+    if (hc->active)
+    {
+        homingStart(homing);
+    }
+
+    homing->state = hc->state;
+    homing->prevstate = hc->entry ? HOMING_STATE_IDLE : hc->state;
+    homing->actuator_dir = (hc->state == HOMING_STATE_MEASURE_EXTEND ||
+                            hc->state == HOMING_STATE_MOVE_TO_CENTER) ?
+                           ACTUATOR_DIR_EXTEND : ACTUATOR_DIR_RETRACT;
+    homing->extend_travel_time_ms = 10000;
+    homing->retract_travel_time_ms = 8000;
+    homing->extend_travel_time_us = 10000000;
+    homing->retract_travel_time_us = 8000000;
+    homing->retract_limit_reached_time = BENCH_NOW - 5000;
+    homing->extend_limit_reached_time = BENCH_NOW - 5000;
+
+    homing->ton_timeout.aux = 1;
+    homing->ton_timeout.since = BENCH_NOW + homing->timeout_ms;
+    homing->ton_settle.aux = 1;
+    homing->ton_settle.since = BENCH_NOW + homing->settle_time_ms;
+    homing->ton_center_move.aux = 1;
+    homing->ton_center_move.since = BENCH_NOW + 1000;
+
+    // Switch levels already confirmed, contact cases see a fresh raw edge
+    uint8_t settled = (hc->state == HOMING_STATE_SETTLE_AT_RETRACT ||
+                       hc->state == HOMING_STATE_SETTLE_AT_EXTEND ||
+                       hc->state == HOMING_STATE_SETTLE_AT_RETRACT_2);
+
+    homing->db_retract_switch.state = settled ? hc->retract : 0;
+    homing->db_retract_switch.raw = settled ? hc->retract : 0;
+    homing->db_retract_switch.ed_raw.aux = settled ? hc->retract : 0;
+    homing->db_extend_switch.state = settled ? hc->extend : 0;
+    homing->db_extend_switch.raw = settled ? hc->extend : 0;
+    homing->db_extend_switch.ed_raw.aux = settled ? hc->extend : 0;
+    homing->retract_switch_debounced = homing->db_retract_switch.state;
+    homing->extend_switch_debounced = homing->db_extend_switch.state;
+    homing->ed_retract_switch.aux = homing->retract_switch_debounced;
+    homing->ed_extend_switch.aux = homing->extend_switch_debounced;
+}
+
+static void resultAdd(bench_result_t *result, uint32_t elapsed, uint32_t calls)
+{
+    uint32_t per_call_x100 = (uint32_t)((uint64_t)elapsed * 100U / calls);
+
+    if (!result->rounds || per_call_x100 < result->min_x100)
+    {
+        result->min_x100 = per_call_x100;
+    }
+
+    result->sum_x100 += per_call_x100;
+    result->rounds++;
+    result->calls += calls;
+}
+
+static void report(const char *suite, const char *name, const bench_result_t *result)
+{
+    uint32_t mean_x100 = result->rounds ? result->sum_x100 / result->rounds : 0;
+
+    BENCH_PRINT("BENCH,%s,%s,%s,%lu.%02lu,%lu.%02lu,%lu\r\n", suite, name, BENCH_UNIT,
+                (unsigned long)(result->min_x100 / 100), (unsigned long)(result->min_x100 % 100),
+                (unsigned long)(mean_x100 / 100), (unsigned long)(mean_x100 % 100),
+                (unsigned long)result->calls);
+}
+
+static void emptyCall(void *obj, uint8_t in)
+{
+    (void)obj;
+    (void)in;
+}
+
+// The telemetry line of app1.c, fmtFormat() against newlib snprintf()
+static void benchFormat(void)
+{
+    static const char *const names[] = { "fmt", "snprintf" };
+    char line[96];
+
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        bench_result_t result;
+        uint32_t chars = 0;
+
+        memset(&result, 0, sizeof(result));
+
+        for (uint32_t r = 0; r < BENCH_ROUNDS; ++r)
+        {
+            uint32_t t0 = benchNow();
+
+            for (uint32_t i = 0; i < BENCH_BATCH; ++i)
+            {
+                int32_t temp_x100 = 2150 + (int32_t)i * 25;
+                float temp = (float)temp_x100 / 100.0f;
+
+                if (c == 0)
+                {
+                    char temp_text[12];
+
+                    chars += fmtFormat(line, sizeof(line), "ALL:%5s,%d,%d,%d,%d,%d,%lu\n",
+                                       fmtFixed(temp_text, sizeof(temp_text), temp_x100, 2),
+                                       1, 0, 120, 45, 200, (unsigned long)r);
+                }
+                else
+                {
+                    chars += (uint32_t)snprintf(line, sizeof(line), "ALL:%5.2f,%d,%d,%d,%d,%d,%lu\n",
+                                                temp, 1, 0, 120, 45, 200, (unsigned long)r);
+                }
+            }
+
+            resultAdd(&result, benchNow() - t0, BENCH_BATCH);
+        }
+
+        sink = chars;
+        report("format", names[c], &result);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+ * Micro-benchmarks of the hot primitives. Host build (ns, steady_clock on
+ * clock_gettime):
+ *
+ *   gcc -O2 -DBENCH_HOST -DSTEADY_CLOCK_HOST -IInc -ITools/bench \
+ *       Tools/bench/bench.c Src/steady_clock.c Src/ton.c Src/edge_detection.c \
+ *       Src/debounce.c Src/running_stat.c Src/trace.c Src/homing*.c Src/fmt.c \
+ *       -o bench
+ *
+ * On the target (cycles, DWT CYCCNT through steady_clock) add bench.c to the
+ * firmware and call benchRunAll() once after steadyClockEnable(), the lines
+ * go out through print().
+ *
+ * Output is CSV: BENCH,suite,case,unit,min,mean,calls. min and mean are per
+ * call, include the loop and call overhead and are best read against the
+ * "baseline" rows.
+ */
+
+void benchRunAll(void);
+
+#endif
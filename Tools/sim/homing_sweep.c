@@ -0,0 +1,384 @@
+/*
+ * Monte Carlo sweep of the homing parameters against randomized plants,
+ * one CSV line per parameter combination on stdout.
+ *
+ *   gcc -O2 -pthread -IInc -ITools/sim Tools/sim/homing_sweep.c Tools/sim/plant_sim.c \
+ *       Src/homing*.c Src/ton.c Src/edge_detection.c Src/debounce.c \
+ *       Src/running_stat.c Src/trace.c Src/fmt.c -o homing_sweep
+ *
+ *   ./homing_sweep -n 100000 -d 20,50,80 -s 50,100 -o 30000 -m 50,100,200
+ *
+ * Runs are seeded from (seed, combination, run) only, so results do not
+ * depend on the thread count.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "plant_sim.h"
+
+#define MAX_VALUES          16
+#define RUNS_PER_UNIT       256
+#define RUN_LIMIT_MS        600000U
+
+typedef struct
+{
+    uint32_t value[MAX_VALUES];
+    uint32_t count;
+} value_list_t;
+
+typedef struct
+{
+    uint32_t debounce_ms;
+    uint32_t settle_ms;
+    uint32_t timeout_ms;
+    uint32_t min_travel_ms;
+} combo_t;
+
+typedef struct
+{
+    uint64_t runs;
+    uint64_t homed;
+    uint64_t false_error;
+    uint64_t fault_runs;
+    uint64_t fault_detected;
+    uint64_t center_err_sum_um;
+    uint32_t center_err_max_um;
+    uint64_t time_sum_ms;
+    uint32_t time_max_ms;
+} sweep_stat_t;
+
+typedef struct
+{
+    uint32_t runs;
+    uint32_t spread_pct;        // extend speed +-
+    uint32_t max_lag_ms;
+    uint32_t max_bounce_ms;
+    uint32_t max_noise_ppm;
+    uint32_t fault_pct;
+    uint32_t pwm;
+    uint64_t seed;
+} sweep_config_t;
+
+typedef struct
+{
+    const sweep_config_t *cfg;
+    const combo_t *combos;
+    uint32_t combo_count;
+    uint32_t units_per_combo;
+    uint32_t next_unit;         // shared, taken with an atomic add
+} sweep_job_t;
+
+typedef struct
+{
+    sweep_job_t *job;
+    sweep_stat_t *stat;         // one per combination, private to the thread
+    pthread_t thread;
+} sweep_worker_t;
+
+static uint64_t splitmix64(uint64_t *state);
+static uint32_t randomRange(uint64_t *state, uint32_t lo, uint32_t hi);
+static void randomPlant(const sweep_config_t *cfg, uint64_t *rng, plant_config_t *plant_cfg, uint8_t *faulty);
+static void runOne(const sweep_config_t *cfg, const combo_t *combo, uint64_t rng, sweep_stat_t *stat);
+static void *worker(void *arg);
+static void parseList(const char *arg, value_list_t *list);
+static void usage(const char *name);
+
+
+int main(int argc, char **argv)
+{
+    sweep_config_t cfg = { 10000, 20, 50, 20, 0, 0, 0, 1 };
+    value_list_t debounce = { { HOMING_DEBOUNCE_TIME }, 1 };
+    value_list_t settle = { { HOMING_SETTLE_TIME }, 1 };
+    value_list_t timeout = { { HOMING_TIMEOUT }, 1 };
+    value_list_t min_travel = { { HOMING_MIN_TRAVEL_TIME }, 1 };
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:t:d:s:o:m:v:l:b:N:f:pS:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': cfg.runs = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 't': threads = strtol(optarg, NULL, 0); break;
+            case 'd': parseList(optarg, &debounce); break;
+            case 's': parseList(optarg, &settle); break;
+            case 'o': parseList(optarg, &timeout); break;
+            case 'm': parseList(optarg, &min_travel); break;
+            case 'v': cfg.spread_pct = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'l': cfg.max_lag_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'b': cfg.max_bounce_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'N': cfg.max_noise_ppm = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'f': cfg.fault_pct = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'p': cfg.pwm = 1; break;
+            case 'S': cfg.seed = strtoull(optarg, NULL, 0); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    if (threads < 1 || cfg.runs == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    uint32_t combo_count = debounce.count * settle.count * timeout.count * min_travel.count;
+    combo_t *combos = calloc(combo_count, sizeof(combo_t));
+    uint32_t n = 0;
+
+    for (uint32_t a = 0; a < debounce.count; ++a)
+        for (uint32_t b = 0; b < settle.count; ++b)
+            for (uint32_t c = 0; c < timeout.count; ++c)
+                for (uint32_t d = 0; d < min_travel.count; ++d)
+                {
+                    combos[n].debounce_ms = debounce.value[a];
+                    combos[n].settle_ms = settle.value[b];
+                    combos[n].timeout_ms = timeout.value[c];
+                    combos[n].min_travel_ms = min_travel.value[d];
+                    n++;
+                }
+
+    sweep_job_t job = { &cfg, combos, combo_count, (cfg.runs + RUNS_PER_UNIT - 1) / RUNS_PER_UNIT, 0 };
+    sweep_worker_t *workers = calloc((size_t)threads, sizeof(sweep_worker_t));
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (long i = 0; i < threads; ++i)
+    {
+        workers[i].job = &job;
+        workers[i].stat = calloc(combo_count, sizeof(sweep_stat_t));
+        pthread_create(&workers[i].thread, NULL, worker, &workers[i]);
+    }
+
+    for (long i = 0; i < threads; ++i)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    printf("debounce_ms,settle_ms,timeout_ms,min_travel_ms,runs,success_pct,false_error_pct,"
+           "fault_runs,fault_detect_pct,center_err_mean_um,center_err_max_um,time_mean_ms,time_max_ms\n");
+
+    for (uint32_t c = 0; c < combo_count; ++c)
+    {
+        sweep_stat_t total;
+        memset(&total, 0, sizeof(total));
+
+        for (long i = 0; i < threads; ++i)
+        {
+            const sweep_stat_t *s = &workers[i].stat[c];
+
+            total.runs += s->runs;
+            total.homed += s->homed;
+            total.false_error += s->false_error;
+            total.fault_runs += s->fault_runs;
+            total.fault_detected += s->fault_detected;
+            total.center_err_sum_um += s->center_err_sum_um;
+            total.time_sum_ms += s->time_sum_ms;
+            total.center_err_max_um = (s->center_err_max_um > total.center_err_max_um) ?
+                                      s->center_err_max_um : total.center_err_max_um;
+            total.time_max_ms = (s->time_max_ms > total.time_max_ms) ? s->time_max_ms : total.time_max_ms;
+        }
+
+        uint64_t healthy = total.runs - total.fault_runs;
+
+        printf("%u,%u,%u,%u,%llu,%.3f,%.3f,%llu,%.3f,%.1f,%u,%.1f,%u\n",
+               combos[c].debounce_ms, combos[c].settle_ms, combos[c].timeout_ms, combos[c].min_travel_ms,
+               (unsigned long long)total.runs,
+               healthy ? 100.0 * total.homed / healthy : 0.0,
+               healthy ? 100.0 * total.false_error / healthy : 0.0,
+               (unsigned long long)total.fault_runs,
+               total.fault_runs ? 100.0 * total.fault_detected / total.fault_runs : 0.0,
+               total.homed ? (double)total.center_err_sum_um / total.homed : 0.0,
+               total.center_err_max_um,
+               total.homed ? (double)total.time_sum_ms / total.homed : 0.0,
+               total.time_max_ms);
+    }
+
+    double secs = (double)(t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    double runs = (double)cfg.runs * combo_count;
+
+    fprintf(stderr, "%.0f runs on %ld threads in %.2f s, %.0f runs/s\n", runs, threads, secs, runs / secs);
+
+    for (long i = 0; i < threads; ++i)
+    {
+        free(workers[i].stat);
+    }
+
+    free(workers);
+    free(combos);
+
+    return 0;
+}
+
+
+static void *worker(void *arg)
+{
+    sweep_worker_t *self = arg;
+    sweep_job_t *job = self->job;
+    const sweep_config_t *cfg = job->cfg;
+    uint32_t unit_count = job->combo_count * job->units_per_combo;
+
+    for (;;)
+    {
+        uint32_t unit = __atomic_fetch_add(&job->next_unit, 1U, __ATOMIC_RELAXED);
+
+        if (unit >= unit_count)
+        {
+            break;
+        }
+
+        uint32_t combo = unit / job->units_per_combo;
+        uint32_t first = (unit % job->units_per_combo) * RUNS_PER_UNIT;
+        uint32_t last = first + RUNS_PER_UNIT;
+
+        last = (last > cfg->runs) ? cfg->runs : last;
+
+        for (uint32_t run = first; run < last; ++run)
+        {
+            uint64_t rng = cfg->seed ^ ((uint64_t)combo << 40) ^ run;
+
+            splitmix64(&rng);
+            runOne(cfg, &job->combos[combo], rng, &self->stat[combo]);
+        }
+    }
+
+    return NULL;
+}
+
+static void runOne(const sweep_config_t *cfg, const combo_t *combo, uint64_t rng, sweep_stat_t *stat)
+{
+    plant_config_t plant_cfg;
+    plant_t plant;
+    homing_funcs_t funcs;
+    homing_t homing;
+    plant_result_t result;
+    uint8_t faulty;
+
+    randomPlant(cfg, &rng, &plant_cfg, &faulty);
+    plantInit(&plant, &plant_cfg);
+    plantBind(&plant);
+    plantGetFuncs(&funcs, cfg->pwm ? PLANT_FUNCS_PWM : 0);
+
+    homingInit(&homing, &funcs);
+    homing.debounce_time_ms = combo->debounce_ms;
+    homing.settle_time_ms = combo->settle_ms;
+    homing.timeout_ms = combo->timeout_ms;
+    homing.phase_timeout_ms = combo->timeout_ms;
+    homing.min_travel_time_ms = combo->min_travel_ms;
+
+    homingStart(&homing);
+    plantRunHoming(&plant, &homing, RUN_LIMIT_MS, &result);
+
+    stat->runs++;
+
+    if (faulty)
+    {
+        stat->fault_runs++;
+        stat->fault_detected += !result.homed;
+        return;
+    }
+
+    if (!result.homed)
+    {
+        stat->false_error++;
+        return;
+    }
+
+    uint32_t err = (uint32_t)((result.center_error_um < 0) ? -result.center_error_um : result.center_error_um);
+
+    stat->homed++;
+    stat->center_err_sum_um += err;
+    stat->center_err_max_um = (err > stat->center_err_max_um) ? err : stat->center_err_max_um;
+    stat->time_sum_ms += result.time_ms;
+    stat->time_max_ms = (result.time_ms > stat->time_max_ms) ? result.time_ms : stat->time_max_ms;
+}
+
+static void randomPlant(const sweep_config_t *cfg, uint64_t *rng, plant_config_t *plant_cfg, uint8_t *faulty)
+{
+    plantDefaultConfig(plant_cfg);
+
+    uint32_t nominal = plant_cfg->extend_speed_um_s;
+
+    plant_cfg->extend_speed_um_s = randomRange(rng, nominal * (100 - cfg->spread_pct) / 100,
+                                               nominal * (100 + cfg->spread_pct) / 100);
+    // Retract from 0.8 to 1.5 times the extend speed
+    plant_cfg->retract_speed_um_s = plant_cfg->extend_speed_um_s * randomRange(rng, 80, 150) / 100;
+    plant_cfg->start_pos_um = randomRange(rng, plant_cfg->retract_trip_um + 1, plant_cfg->extend_trip_um - 1);
+    plant_cfg->start_lag_us = randomRange(rng, 0, cfg->max_lag_ms * 1000);
+    plant_cfg->bounce_us = randomRange(rng, 0, cfg->max_bounce_ms * 1000);
+    plant_cfg->noise_ppm = randomRange(rng, 0, cfg->max_noise_ppm);
+    plant_cfg->seed = (uint32_t)splitmix64(rng) | 1U;
+
+    *faulty = randomRange(rng, 0, 99) < cfg->fault_pct;
+
+    if (*faulty)
+    {
+        plant_switch_fault_t fault = randomRange(rng, 0, 1) ? PLANT_SWITCH_STUCK_CLOSED : PLANT_SWITCH_NEVER_CLOSES;
+
+        if (randomRange(rng, 0, 1))
+        {
+            plant_cfg->retract_fault = fault;
+        }
+        else
+        {
+            plant_cfg->extend_fault = fault;
+        }
+    }
+}
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+// Uniform in [lo, hi]
+static uint32_t randomRange(uint64_t *state, uint32_t lo, uint32_t hi)
+{
+    if (hi <= lo)
+    {
+        return lo;
+    }
+
+    return lo + (uint32_t)(((splitmix64(state) >> 32) * ((uint64_t)hi - lo + 1)) >> 32);
+}
+
+static void parseList(const char *arg, value_list_t *list)
+{
+    char *end;
+
+    list->count = 0;
+
+    while (*arg && list->count < MAX_VALUES)
+    {
+        list->value[list->count++] = (uint32_t)strtoul(arg, &end, 0);
+        arg = (*end == ',') ? end + 1 : end;
+
+        if (end == arg && *arg)
+        {
+            break;
+        }
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-n runs per combination] [-t threads]\n"
+            "  parameter lists, comma separated:\n"
+            "  -d debounce ms  -s settle ms  -o timeout ms  -m min travel ms\n"
+            "  plant model:\n"
+            "  -v speed spread %%  -l max start lag ms  -b max bounce ms\n"
+            "  -N max noise ppm  -f fault %%  -p PWM profile  -S seed\n",
+            name);
+}
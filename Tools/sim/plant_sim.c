@@ -0,0 +1,481 @@
+#include "plant_sim.h"
+#include "string.h"
+
+#define EDGE_QUEUE_MASK (PLANT_EDGE_QUEUE_SIZE - 1U)
+#define NO_EVENT        0xFFFFFFFFU
+
+// The homing callbacks carry no context, each thread drives its own plant
+static __thread plant_t *bound_plant;
+
+static void stepMs(plant_t *plant, uint32_t ms);
+static void updateSwitch(plant_t *plant, homing_switch_t which, uint64_t change_us);
+static uint8_t physicalContact(const plant_t *plant, homing_switch_t which);
+static uint32_t speedUmPerSec(const plant_t *plant);
+static uint32_t msToReach(const plant_t *plant, int64_t target_nm);
+static uint32_t random32(plant_t *plant);
+
+static void simSetActuatorDirection(actuator_direction_t dir);
+static void simSetActuatorDuty(uint8_t duty_percent);
+static uint8_t simReadRetractSwitch(void);
+static uint8_t simReadExtendSwitch(void);
+static uint32_t simGetSysTick(void);
+static uint32_t simGetMicros(void);
+static void simArmSwitchEdge(homing_switch_t which);
+static uint8_t simPopSwitchEdge(homing_switch_edge_t *edge);
+
+
+// 100 mm stroke, 10 / 12.5 mm/s, switches 0.5 mm before the end stops
+void plantDefaultConfig(plant_config_t *cfg)
+{
+    memset(cfg, 0, sizeof(plant_config_t));
+
+    cfg->stroke_um = 100000;
+    cfg->retract_trip_um = 500;
+    cfg->extend_trip_um = 99500;
+    cfg->start_pos_um = 30000;
+    cfg->extend_speed_um_s = 10000;
+    cfg->retract_speed_um_s = 12500;
+    cfg->start_lag_us = 0;
+    cfg->bounce_us = 0;
+    cfg->noise_ppm = 0;
+    cfg->retract_fault = PLANT_SWITCH_OK;
+    cfg->extend_fault = PLANT_SWITCH_OK;
+    cfg->seed = 1;
+}
+
+void plantInit(plant_t *plant, const plant_config_t *cfg)
+{
+    memset(plant, 0, sizeof(plant_t));
+
+    plant->cfg = *cfg;
+    plant->pos_nm = (int64_t)cfg->start_pos_um * 1000;
+    plant->dir = ACTUATOR_DIR_STOP;
+    plant->duty = 100;
+    plant->rng = cfg->seed ? cfg->seed : 1;
+
+    plant->contact[HOMING_SWITCH_RETRACT] = physicalContact(plant, HOMING_SWITCH_RETRACT);
+    plant->contact[HOMING_SWITCH_EXTEND] = physicalContact(plant, HOMING_SWITCH_EXTEND);
+    plant->level[HOMING_SWITCH_RETRACT] = plant->contact[HOMING_SWITCH_RETRACT];
+    plant->level[HOMING_SWITCH_EXTEND] = plant->contact[HOMING_SWITCH_EXTEND];
+}
+
+// Route the homing callbacks of the calling thread to plant
+void plantBind(plant_t *plant)
+{
+    bound_plant = plant;
+}
+
+void plantGetFuncs(homing_funcs_t *funcs, uint8_t options)
+{
+    memset(funcs, 0, sizeof(homing_funcs_t));
+
+    funcs->setActuatorDirection = simSetActuatorDirection;
+    funcs->readRetractSwitch = simReadRetractSwitch;
+    funcs->readExtendSwitch = simReadExtendSwitch;
+    funcs->getSysTick = simGetSysTick;
+
+    if (options & PLANT_FUNCS_PWM)
+    {
+        funcs->setActuatorDuty = simSetActuatorDuty;
+    }
+
+    if (options & PLANT_FUNCS_EDGE_CAPTURE)
+    {
+        funcs->getMicros = simGetMicros;
+        funcs->armSwitchEdge = simArmSwitchEdge;
+        funcs->popSwitchEdge = simPopSwitchEdge;
+    }
+}
+
+void plantAdvance(plant_t *plant, uint32_t ms)
+{
+    while (ms)
+    {
+        // Up to the ms before the next possible switch change in one go
+        uint32_t quiet = plantNextEventMs(plant) - 1U;
+        uint32_t step = (quiet >= ms) ? ms : (quiet ? quiet : 1U);
+
+        stepMs(plant, step);
+        ms -= step;
+    }
+}
+
+/**
+ * \brief Whole ms until a switch reading can change, NO_EVENT if never.
+ * Noise and bounce change readings at random, so those report 1.
+ */
+uint32_t plantNextEventMs(const plant_t *plant)
+{
+    if (plant->cfg.noise_ppm ||
+        plant->now_us < plant->bounce_end_us[HOMING_SWITCH_RETRACT] ||
+        plant->now_us < plant->bounce_end_us[HOMING_SWITCH_EXTEND])
+    {
+        return 1;
+    }
+
+    if ((plant->dir == ACTUATOR_DIR_STOP && plant->speed_um_s) ||
+        (plant->dir != ACTUATOR_DIR_STOP && plant->now_us >= plant->motion_start_us &&
+         plant->speed_um_s != speedUmPerSec(plant)))
+    {
+        // Accelerating or coasting
+        return 1;
+    }
+
+    if (plant->dir == ACTUATOR_DIR_STOP)
+    {
+        return NO_EVENT;
+    }
+
+    if (plant->now_us < plant->motion_start_us)
+    {
+        return (uint32_t)((plant->motion_start_us - plant->now_us + 999) / 1000);
+    }
+
+    uint32_t next = NO_EVENT;
+    uint32_t ms;
+
+    if (plant->cfg.retract_fault == PLANT_SWITCH_OK)
+    {
+        ms = msToReach(plant, (int64_t)plant->cfg.retract_trip_um * 1000);
+        next = (ms < next) ? ms : next;
+    }
+
+    if (plant->cfg.extend_fault == PLANT_SWITCH_OK)
+    {
+        ms = msToReach(plant, (int64_t)plant->cfg.extend_trip_um * 1000);
+        next = (ms < next) ? ms : next;
+    }
+
+    return next;
+}
+
+uint32_t plantGetTick(const plant_t *plant)
+{
+    return (uint32_t)(plant->now_us / 1000);
+}
+
+int32_t plantGetPositionUm(const plant_t *plant)
+{
+    return (int32_t)(plant->pos_nm / 1000);
+}
+
+/**
+ * \brief Run a started homing (or positioning move) to its end. The virtual
+ * clock jumps from one event to the next: a homing deadline, a switch
+ * crossing, or every ms while bounce or noise is active.
+ * \return 1 if it finished within limit_ms
+ */
+uint8_t plantRunHoming(plant_t *plant, homing_t *homing, uint32_t limit_ms, plant_result_t *result)
+{
+    uint32_t start = plantGetTick(plant);
+    uint32_t deadline = 0;
+    uint32_t passes = 1;
+
+    plantBind(plant);
+
+    uint8_t timed = homingProcessEvent(homing, start, &deadline);
+
+    while (homingIsActive(homing) || homingIsMoving(homing))
+    {
+        uint32_t now = plantGetTick(plant);
+        uint32_t step = plantNextEventMs(plant);
+
+        if (now - start >= limit_ms)
+        {
+            break;
+        }
+
+        if (timed)
+        {
+            int32_t due = (int32_t)(deadline - now);
+            uint32_t due_ms = (due > 0) ? (uint32_t)due : 1;
+
+            step = (due_ms < step) ? due_ms : step;
+        }
+        else if (step == NO_EVENT)
+        {
+            // Nothing can ever wake it up
+            break;
+        }
+
+        if (step > limit_ms - (now - start))
+        {
+            step = limit_ms - (now - start);
+        }
+
+        uint8_t retract = plant->level[HOMING_SWITCH_RETRACT];
+        uint8_t extend = plant->level[HOMING_SWITCH_EXTEND];
+
+        plantAdvance(plant, step);
+        now = plantGetTick(plant);
+
+        if (retract != plant->level[HOMING_SWITCH_RETRACT] ||
+            extend != plant->level[HOMING_SWITCH_EXTEND] ||
+            (timed && (int32_t)(now - deadline) >= 0))
+        {
+            timed = homingProcessEvent(homing, now, &deadline);
+            passes++;
+        }
+    }
+
+    if (result)
+    {
+        int32_t center_um = (int32_t)((plant->cfg.retract_trip_um + plant->cfg.extend_trip_um) / 2);
+
+        result->homed = homingIsComplete(homing);
+        result->error = homingGetError(homing);
+        result->time_ms = plantGetTick(plant) - start;
+        result->passes = passes;
+        result->center_error_um = plantGetPositionUm(plant) - center_um;
+    }
+
+    return !homingIsActive(homing) && !homingIsMoving(homing);
+}
+
+
+static void stepMs(plant_t *plant, uint32_t ms)
+{
+    uint64_t t0 = plant->now_us;
+    uint64_t t1 = t0 + (uint64_t)ms * 1000;
+    uint64_t move_from = (plant->motion_start_us > t0) ? plant->motion_start_us : t0;
+    int64_t prev_nm = plant->pos_nm;
+    uint32_t target = (move_from < t1) ? speedUmPerSec(plant) : 0;
+    uint32_t speed = target;
+
+    // Ramps are stepped 1 ms at a time, see plantNextEventMs()
+    if (plant->dir != ACTUATOR_DIR_STOP && plant->cfg.accel_us && plant->speed_um_s < target)
+    {
+        uint32_t gain = (uint32_t)((uint64_t)target * (t1 - move_from) / plant->cfg.accel_us);
+
+        speed = (plant->speed_um_s + gain < target) ? plant->speed_um_s + gain : target;
+    }
+    else if (plant->dir == ACTUATOR_DIR_STOP && plant->speed_um_s)
+    {
+        uint32_t loss = (uint32_t)((uint64_t)plant->coast_from_um_s * 1000 / plant->cfg.coast_us);
+
+        speed = (plant->speed_um_s > loss) ? plant->speed_um_s - loss : 0;
+        move_from = t0;
+    }
+
+    uint32_t mean = (plant->dir != ACTUATOR_DIR_STOP && !plant->cfg.accel_us) ?
+                    speed : (plant->speed_um_s + speed) / 2;
+
+    plant->speed_um_s = speed;
+    speed = mean;
+
+    if (move_from < t1 && speed)
+    {
+        // um/s is nm/ms
+        int64_t delta_nm = (int64_t)speed * (int64_t)(t1 - move_from) / 1000;
+
+        plant->pos_nm += (plant->move_dir == ACTUATOR_DIR_EXTEND) ? delta_nm : -delta_nm;
+
+        if (plant->pos_nm < 0)
+        {
+            plant->pos_nm = 0;
+        }
+        else if (plant->pos_nm > (int64_t)plant->cfg.stroke_um * 1000)
+        {
+            plant->pos_nm = (int64_t)plant->cfg.stroke_um * 1000;
+        }
+    }
+
+    plant->now_us = t1;
+
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+        homing_switch_t which = (homing_switch_t)i;
+        int64_t trip_nm = (int64_t)((which == HOMING_SWITCH_RETRACT) ?
+                                    plant->cfg.retract_trip_um : plant->cfg.extend_trip_um) * 1000;
+        int64_t dist = trip_nm - prev_nm;
+
+        // Crossing time inside this step for the edge capture
+        uint64_t change_us = t1;
+        if (speed && dist)
+        {
+            change_us = move_from + (uint64_t)((dist < 0 ? -dist : dist) * 1000 / speed);
+            change_us = (change_us > t1) ? t1 : change_us;
+        }
+
+        updateSwitch(plant, which, change_us);
+    }
+}
+
+static void updateSwitch(plant_t *plant, homing_switch_t which, uint64_t change_us)
+{
+    uint8_t contact = physicalContact(plant, which);
+    uint8_t closed = 0;
+
+    if (contact != plant->contact[which])
+    {
+        plant->contact[which] = contact;
+        plant->bounce_end_us[which] = change_us + plant->cfg.bounce_us;
+        closed = contact;
+    }
+
+    uint8_t level = plant->contact[which];
+
+    if (plant->now_us < plant->bounce_end_us[which])
+    {
+        level = random32(plant) & 1U;
+    }
+
+    if (plant->cfg.noise_ppm && random32(plant) % 1000000U < plant->cfg.noise_ppm)
+    {
+        level = !level;
+    }
+
+    // Like the EXTI capture: the first rising edge while armed, bounce and
+    // noise included. A closing contact rises at its crossing time.
+    if ((closed || (level && !plant->level[which])) && plant->armed[which])
+    {
+        uint8_t next = (uint8_t)((plant->edge_head + 1U) & EDGE_QUEUE_MASK);
+
+        if (next != plant->edge_tail)
+        {
+            plant->edge_queue[plant->edge_head].which = which;
+            plant->edge_queue[plant->edge_head].timestamp_us = (uint32_t)(closed ? change_us : plant->now_us);
+            plant->edge_head = next;
+        }
+
+        plant->armed[which] = 0;
+    }
+
+    plant->level[which] = level;
+}
+
+static uint8_t physicalContact(const plant_t *plant, homing_switch_t which)
+{
+    plant_switch_fault_t fault = (which == HOMING_SWITCH_RETRACT) ?
+                                 plant->cfg.retract_fault : plant->cfg.extend_fault;
+
+    if (fault == PLANT_SWITCH_STUCK_CLOSED)
+    {
+        return 1;
+    }
+
+    if (fault == PLANT_SWITCH_NEVER_CLOSES)
+    {
+        return 0;
+    }
+
+    if (which == HOMING_SWITCH_RETRACT)
+    {
+        return plant->pos_nm <= (int64_t)plant->cfg.retract_trip_um * 1000;
+    }
+
+    return plant->pos_nm >= (int64_t)plant->cfg.extend_trip_um * 1000;
+}
+
+static uint32_t speedUmPerSec(const plant_t *plant)
+{
+    uint32_t speed = (plant->dir == ACTUATOR_DIR_EXTEND) ? plant->cfg.extend_speed_um_s :
+                     (plant->dir == ACTUATOR_DIR_RETRACT) ? plant->cfg.retract_speed_um_s : 0;
+
+    return (uint32_t)((uint64_t)speed * plant->duty / 100);
+}
+
+// Ms until the actuator crosses target_nm in its current direction
+static uint32_t msToReach(const plant_t *plant, int64_t target_nm)
+{
+    uint32_t speed = speedUmPerSec(plant);
+    int64_t dist = target_nm - plant->pos_nm;
+
+    if (plant->dir == ACTUATOR_DIR_RETRACT)
+    {
+        // Moving off a closed switch opens it at the same trip point
+        dist = -dist;
+    }
+
+    if (!speed || dist < 0)
+    {
+        return NO_EVENT;
+    }
+
+    uint64_t ms = ((uint64_t)dist + speed - 1) / speed;
+
+    return (ms == 0) ? 1 : (ms > 0xFFFFFFF0U) ? NO_EVENT : (uint32_t)ms;
+}
+
+static uint32_t random32(plant_t *plant)
+{
+    // xorshift32
+    uint32_t x = plant->rng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    plant->rng = x;
+
+    return x;
+}
+
+
+static void simSetActuatorDirection(actuator_direction_t dir)
+{
+    plant_t *plant = bound_plant;
+
+    if (dir == plant->dir)
+    {
+        return;
+    }
+
+    if (dir == ACTUATOR_DIR_STOP)
+    {
+        plant->coast_from_um_s = plant->speed_um_s;
+        plant->speed_um_s = plant->cfg.coast_us ? plant->speed_um_s : 0;
+    }
+    else if (dir != plant->move_dir)
+    {
+        plant->speed_um_s = 0;
+    }
+
+    plant->dir = dir;
+    plant->move_dir = (dir != ACTUATOR_DIR_STOP) ? dir : plant->move_dir;
+    plant->motion_start_us = plant->now_us + ((dir != ACTUATOR_DIR_STOP) ? plant->cfg.start_lag_us : 0);
+}
+
+static void simSetActuatorDuty(uint8_t duty_percent)
+{
+    bound_plant->duty = duty_percent;
+}
+
+static uint8_t simReadRetractSwitch(void)
+{
+    return bound_plant->level[HOMING_SWITCH_RETRACT];
+}
+
+static uint8_t simReadExtendSwitch(void)
+{
+    return bound_plant->level[HOMING_SWITCH_EXTEND];
+}
+
+static uint32_t simGetSysTick(void)
+{
+    return plantGetTick(bound_plant);
+}
+
+static uint32_t simGetMicros(void)
+{
+    return (uint32_t)bound_plant->now_us;
+}
+
+static void simArmSwitchEdge(homing_switch_t which)
+{
+    bound_plant->armed[which] = 1;
+}
+
+static uint8_t simPopSwitchEdge(homing_switch_edge_t *edge)
+{
+    plant_t *plant = bound_plant;
+
+    if (plant->edge_tail == plant->edge_head)
+    {
+        return 0;
+    }
+
+    *edge = plant->edge_queue[plant->edge_tail];
+    plant->edge_tail = (uint8_t)((plant->edge_tail + 1U) & EDGE_QUEUE_MASK);
+
+    return 1;
+}
@@ -0,0 +1,96 @@
+#ifndef PLANT_SIM_H
+#define PLANT_SIM_H
+
+/*
+ * Host model of the linear actuator and its two limit switches, driven by a
+ * virtual clock behind homing_funcs_t. Runs the unchanged Src/homing.c, e.g.
+ *
+ *   gcc -O2 -IInc -ITools/sim my_test.c Tools/sim/plant_sim.c Src/homing*.c \
+ *       Src/ton.c Src/edge_detection.c Src/debounce.c Src/running_stat.c Src/trace.c \
+ *       Src/fmt.c
+ */
+
+#include "stdint.h"
+#include "homing.h"
+
+#define PLANT_EDGE_QUEUE_SIZE    4
+
+// plantGetFuncs() options
+#define PLANT_FUNCS_PWM          0x01
+#define PLANT_FUNCS_EDGE_CAPTURE 0x02
+
+typedef enum
+{
+    PLANT_SWITCH_OK = 0,
+    PLANT_SWITCH_STUCK_CLOSED,
+    PLANT_SWITCH_NEVER_CLOSES
+} plant_switch_fault_t;
+
+typedef struct
+{
+    uint32_t stroke_um;
+    uint32_t retract_trip_um;       // retract switch closed at or below
+    uint32_t extend_trip_um;        // extend switch closed at or above
+    uint32_t start_pos_um;
+
+    uint32_t extend_speed_um_s;     // at 100 % duty
+    uint32_t retract_speed_um_s;
+    uint32_t start_lag_us;          // from a new direction to motion
+    uint32_t accel_us;              // standstill to full speed, 0 = at once
+    uint32_t coast_us;              // full speed to standstill after the drive stops
+
+    uint32_t bounce_us;             // random chatter after every contact change
+    uint32_t noise_ppm;             // chance per ms that a reading is inverted
+
+    plant_switch_fault_t retract_fault;
+    plant_switch_fault_t extend_fault;
+
+    uint32_t seed;
+} plant_config_t;
+
+typedef struct
+{
+    plant_config_t cfg;
+
+    uint64_t now_us;
+    int64_t pos_nm;
+    actuator_direction_t dir;
+    actuator_direction_t move_dir;  // last driven direction, kept while coasting
+    uint32_t speed_um_s;
+    uint32_t coast_from_um_s;
+    uint8_t duty;
+    uint64_t motion_start_us;
+
+    // Indexed by homing_switch_t
+    uint8_t contact[2];             // physical contact
+    uint8_t level[2];               // what the MCU reads
+    uint64_t bounce_end_us[2];
+    uint8_t armed[2];
+
+    homing_switch_edge_t edge_queue[PLANT_EDGE_QUEUE_SIZE];
+    uint8_t edge_head;
+    uint8_t edge_tail;
+
+    uint32_t rng;
+} plant_t;
+
+typedef struct
+{
+    uint8_t homed;
+    homing_error_t error;
+    uint32_t time_ms;
+    uint32_t passes;                // homingProcessEvent() calls
+    int32_t center_error_um;        // final position minus the switch span center
+} plant_result_t;
+
+void plantDefaultConfig(plant_config_t *cfg);
+void plantInit(plant_t *plant, const plant_config_t *cfg);
+void plantBind(plant_t *plant);
+void plantGetFuncs(homing_funcs_t *funcs, uint8_t options);
+void plantAdvance(plant_t *plant, uint32_t ms);
+uint32_t plantNextEventMs(const plant_t *plant);
+uint32_t plantGetTick(const plant_t *plant);
+int32_t plantGetPositionUm(const plant_t *plant);
+uint8_t plantRunHoming(plant_t *plant, homing_t *homing, uint32_t limit_ms, plant_result_t *result);
+
+#endif